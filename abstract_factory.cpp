@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <memory>
+#include "instrumentation/factory_instrumentation.h"
 
 // abstract product
 struct IWidget {
@@ -35,8 +36,8 @@ class WinWindow : public IWidget {
 
 // abstract factory
 struct IFactory {
-    virtual std::unique_ptr<IWidget> create_button() = 0;
-    virtual std::unique_ptr<IWidget> create_window() = 0;
+    virtual instrumentation::Unique_Ptr<IWidget> create_button() = 0;
+    virtual instrumentation::Unique_Ptr<IWidget> create_window() = 0;
     virtual ~IFactory() = default;
 };
 
@@ -44,11 +45,11 @@ struct IFactory {
 class OSXFactory : public IFactory {
   public:
     OSXFactory() { std::cout << "Creating the OSXFactory..." << '\n'; }
-    std::unique_ptr<IWidget> create_button() {
-        return std::make_unique<OSXButton>();
+    instrumentation::Unique_Ptr<IWidget> create_button() {
+        return instrumentation::make_unique<OSXButton>();
     }
-    std::unique_ptr<IWidget> create_window() {
-        return std::make_unique<OSXWindow>();
+    instrumentation::Unique_Ptr<IWidget> create_window() {
+        return instrumentation::make_unique<OSXWindow>();
     }
     virtual ~OSXFactory() {
         std::cout << "Destroying the OSXFactory..." << '\n';
@@ -59,11 +60,11 @@ class OSXFactory : public IFactory {
 class WinFactory : public IFactory {
   public:
     WinFactory() { std::cout << "Creating the WinFactory..." << '\n'; }
-    std::unique_ptr<IWidget> create_button() {
-        return std::make_unique<WinButton>();
+    instrumentation::Unique_Ptr<IWidget> create_button() {
+        return instrumentation::make_unique<WinButton>();
     }
-    std::unique_ptr<IWidget> create_window() {
-        return std::make_unique<WinWindow>();
+    instrumentation::Unique_Ptr<IWidget> create_window() {
+        return instrumentation::make_unique<WinWindow>();
     }
     virtual ~WinFactory() {
         std::cout << "Destroying the WinFactory..." << '\n';
@@ -83,10 +84,10 @@ class SuperFactory : public IFactory {
         std::cout << "Changing the IFactory strategy" << '\n';
         _factory = std::move(factory);
     }
-    std::unique_ptr<IWidget> create_button() {
+    instrumentation::Unique_Ptr<IWidget> create_button() {
         return _factory->create_button();
     }
-    std::unique_ptr<IWidget> create_window() {
+    instrumentation::Unique_Ptr<IWidget> create_window() {
         return _factory->create_window();
     }
     ~SuperFactory() { std::cout << "Destroying the SuperFactory..." << '\n'; }
@@ -110,4 +111,8 @@ int main() {
     super_factory.set_factory(std::move(factory));
     super_factory.create_window()->draw();
     std::cout << "--------" << '\n';
+
+    // creation statistics, with -DFACTORY_INSTRUMENTATION=1
+    if (instrumentation::enabled)
+        std::cout << instrumentation::to_json(instrumentation::snapshot());
 }
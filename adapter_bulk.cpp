@@ -0,0 +1,275 @@
+// Adapter design pattern, bulk variant
+// converts whole arrays of legacy button records at once (array of structs
+// and struct of arrays, in both directions) with loops the compiler
+// vectorizes, and adapts an existing OldButton array in place through a
+// zero-copy view
+
+// compile with g++ -std=c++14 -O3 adapter_bulk.cpp -oadapter_bulk
+// (GCC vectorizes the conversion loops from -O3 on)
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "bench/bench.h"
+
+// legacy layout: two corners
+struct Bounds {
+    std::int32_t x1, y1, x2, y2;
+};
+
+// new layout: corner and size, as taken by the new button interface
+struct Extent {
+    std::int32_t x, y, length, height;
+};
+
+// old button with old interface
+class OldButton {
+    Bounds _bounds;
+
+  public:
+    OldButton() = default;
+    OldButton(int x1, int y1, int x2, int y2) : _bounds{x1, y1, x2, y2} {}
+    explicit OldButton(const Bounds& bounds) : _bounds{bounds} {}
+    const Bounds& bounds() const { return _bounds; }
+    void draw_old() const {
+        std::cout << "Old button. Coordinates: (" << _bounds.x1 << ", "
+                  << _bounds.y1 << "), (" << _bounds.x2 << ", " << _bounds.y2
+                  << ")\n";
+    }
+};
+// arrays of OldButton are dense arrays of Bounds
+static_assert(std::is_trivially_copyable<OldButton>::value &&
+                  sizeof(OldButton) == sizeof(Bounds),
+              "OldButton must stay a plain record");
+
+// our shinny new button interface
+struct IButton {
+    virtual void draw() const = 0;
+    virtual Extent extent() const = 0;
+    virtual ~IButton() = default;
+};
+
+// adapter for legacy buttons, one heap object per button
+class AdapterOldButton : public IButton, private OldButton {
+  public:
+    AdapterOldButton(int x, int y, int length, int height)
+        : OldButton(x, y, x + length, y + height) {}
+    void draw() const override { draw_old(); }
+    Extent extent() const override {
+        const Bounds& b = bounds();
+        return {b.x1, b.y1, b.x2 - b.x1, b.y2 - b.y1};
+    }
+};
+
+// struct-of-arrays layouts
+struct Bounds_Soa {
+    std::vector<std::int32_t> x1, y1, x2, y2;
+    explicit Bounds_Soa(std::size_t n) : x1(n), y1(n), x2(n), y2(n) {}
+    std::size_t size() const { return x1.size(); }
+};
+
+struct Extent_Soa {
+    std::vector<std::int32_t> x, y, length, height;
+    explicit Extent_Soa(std::size_t n) : x(n), y(n), length(n), height(n) {}
+    std::size_t size() const { return x.size(); }
+};
+
+// batch conversions, in and out never overlap
+namespace bulk {
+// new records -> legacy buttons (the batch form of AdapterOldButton)
+void adapt(const Extent* __restrict in, std::size_t n,
+           OldButton* __restrict out) {
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = OldButton{Bounds{in[i].x, in[i].y, in[i].x + in[i].length,
+                                  in[i].y + in[i].height}};
+}
+
+// legacy buttons -> new records
+void adapt(const OldButton* __restrict in, std::size_t n,
+           Extent* __restrict out) {
+    for (std::size_t i = 0; i < n; ++i) {
+        const Bounds& b = in[i].bounds();
+        out[i] = Extent{b.x1, b.y1, b.x2 - b.x1, b.y2 - b.y1};
+    }
+}
+
+// out[i] = a[i] + b[i]
+void add(const std::int32_t* __restrict a, const std::int32_t* __restrict b,
+         std::size_t n, std::int32_t* __restrict out) {
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = a[i] + b[i];
+}
+
+// new records, struct of arrays -> legacy, struct of arrays; one column at a
+// time, each column is a copy or a plain vector add
+// the first n records are converted
+void adapt(const Extent_Soa& in, std::size_t n, Bounds_Soa& out) {
+    std::copy_n(in.x.begin(), n, out.x1.begin());
+    std::copy_n(in.y.begin(), n, out.y1.begin());
+    add(in.x.data(), in.length.data(), n, out.x2.data());
+    add(in.y.data(), in.height.data(), n, out.y2.data());
+}
+
+// legacy buttons <-> struct of arrays, the first n records are converted
+void to_soa(const OldButton* __restrict in, std::size_t n, Bounds_Soa& out) {
+    std::int32_t* __restrict x1 = out.x1.data();
+    std::int32_t* __restrict y1 = out.y1.data();
+    std::int32_t* __restrict x2 = out.x2.data();
+    std::int32_t* __restrict y2 = out.y2.data();
+    for (std::size_t i = 0; i < n; ++i) {
+        const Bounds& b = in[i].bounds();
+        x1[i] = b.x1;
+        y1[i] = b.y1;
+        x2[i] = b.x2;
+        y2[i] = b.y2;
+    }
+}
+
+void from_soa(const Bounds_Soa& in, std::size_t n, OldButton* __restrict out) {
+    const std::int32_t* __restrict x1 = in.x1.data();
+    const std::int32_t* __restrict y1 = in.y1.data();
+    const std::int32_t* __restrict x2 = in.x2.data();
+    const std::int32_t* __restrict y2 = in.y2.data();
+    for (std::size_t i = 0; i < n; ++i)
+        out[i] = OldButton{Bounds{x1[i], y1[i], x2[i], y2[i]}};
+}
+} // namespace bulk
+
+// zero-copy adapter: presents one element of an OldButton array through
+// the new interface, computing the new coordinates on the fly
+class Old_Button_Ref : public IButton {
+    const OldButton* _button;
+
+  public:
+    explicit Old_Button_Ref(const OldButton& button) : _button{&button} {}
+    std::int32_t x() const { return _button->bounds().x1; }
+    std::int32_t y() const { return _button->bounds().y1; }
+    std::int32_t length() const {
+        return _button->bounds().x2 - _button->bounds().x1;
+    }
+    std::int32_t height() const {
+        return _button->bounds().y2 - _button->bounds().y1;
+    }
+    void draw() const override { _button->draw_old(); }
+    Extent extent() const override { return {x(), y(), length(), height()}; }
+};
+
+// zero-copy view over an existing OldButton array, the array must outlive
+// the view
+class Old_Button_View {
+    const OldButton* _first;
+    std::size_t _size;
+
+  public:
+    Old_Button_View(const OldButton* first, std::size_t size)
+        : _first{first}, _size{size} {}
+    explicit Old_Button_View(const std::vector<OldButton>& buttons)
+        : Old_Button_View{buttons.data(), buttons.size()} {}
+    std::size_t size() const { return _size; }
+    Old_Button_Ref operator[](std::size_t i) const {
+        return Old_Button_Ref{_first[i]};
+    }
+    template <typename F>
+    void for_each(F f) const {
+        for (std::size_t i = 0; i < _size; ++i)
+            f(Old_Button_Ref{_first[i]});
+    }
+};
+
+int main(int argc, char** argv) {
+    // migrate a few records and look at them through the new interface
+    std::vector<Extent> records{{100, 100, 40, 10}, {0, 0, 5, 5}};
+    std::vector<OldButton> legacy(records.size());
+    bulk::adapt(records.data(), records.size(), legacy.data());
+    Old_Button_View view{legacy};
+    view.for_each([](const IButton& button) { button.draw(); });
+    std::cout << "Length of the first button: " << view[0].length()
+              << "\n\n";
+
+    const std::size_t N = 1 << 18;
+    std::vector<Extent> extents(N);
+    for (std::size_t i = 0; i < N; ++i)
+        extents[i] = Extent{static_cast<std::int32_t>(i % 1024),
+                            static_cast<std::int32_t>(i % 768),
+                            static_cast<std::int32_t>(i % 64 + 1),
+                            static_cast<std::int32_t>(i % 16 + 1)};
+    Extent_Soa extents_soa{N};
+    for (std::size_t i = 0; i < N; ++i) {
+        extents_soa.x[i] = extents[i].x;
+        extents_soa.y[i] = extents[i].y;
+        extents_soa.length[i] = extents[i].length;
+        extents_soa.height[i] = extents[i].height;
+    }
+    std::vector<OldButton> buttons(N);
+    bulk::adapt(extents.data(), N, buttons.data());
+    std::vector<std::unique_ptr<IButton>> adapters;
+    for (auto&& e : extents)
+        adapters.push_back(
+            std::make_unique<AdapterOldButton>(e.x, e.y, e.length, e.height));
+    std::vector<Extent> extents_out(N);
+    Bounds_Soa bounds_soa{N};
+
+    // ops are records converted or read, in passes of at most N records
+    bench::Suite suite{"adapter_bulk", argc, argv};
+    suite.add("convert/per_object_adapters", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N) {
+            std::size_t m = std::min(N, n - i);
+            std::vector<std::unique_ptr<IButton>> out;
+            out.reserve(m);
+            for (std::size_t j = 0; j < m; ++j)
+                out.push_back(std::make_unique<AdapterOldButton>(
+                    extents[j].x, extents[j].y, extents[j].length,
+                    extents[j].height));
+            bench::do_not_optimize(out.back().get());
+        }
+    });
+    suite.add("convert/bulk_aos", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N)
+            bulk::adapt(extents.data(), std::min(N, n - i), buttons.data());
+        bench::do_not_optimize(buttons.front());
+    });
+    suite.add("convert/bulk_soa", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N)
+            bulk::adapt(extents_soa, std::min(N, n - i), bounds_soa);
+        bench::do_not_optimize(bounds_soa.x2.front());
+    });
+    suite.add("convert/bulk_aos_back", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N)
+            bulk::adapt(buttons.data(), std::min(N, n - i),
+                        extents_out.data());
+        bench::do_not_optimize(extents_out.front());
+    });
+    suite.add("transpose/aos_to_soa", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N)
+            bulk::to_soa(buttons.data(), std::min(N, n - i), bounds_soa);
+        bench::do_not_optimize(bounds_soa.x2.front());
+    });
+    suite.add("transpose/soa_to_aos", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N)
+            bulk::from_soa(bounds_soa, std::min(N, n - i), buttons.data());
+        bench::do_not_optimize(buttons.front());
+    });
+    suite.add("read/per_object_adapters", [&](std::size_t n) {
+        std::int64_t sum = 0;
+        for (std::size_t i = 0; i < n; i += N) {
+            std::size_t m = std::min(N, n - i);
+            for (std::size_t j = 0; j < m; ++j)
+                sum += adapters[j]->extent().length;
+        }
+        bench::do_not_optimize(sum);
+    });
+    suite.add("read/view", [&](std::size_t n) {
+        std::int64_t sum = 0;
+        for (std::size_t i = 0; i < n; i += N) {
+            Old_Button_View buttons_view{buttons.data(), std::min(N, n - i)};
+            buttons_view.for_each(
+                [&sum](const Old_Button_Ref& ref) { sum += ref.length(); });
+        }
+        bench::do_not_optimize(sum);
+    });
+    return suite.run();
+}
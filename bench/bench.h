@@ -0,0 +1,312 @@
+// Self-contained micro-benchmark harness
+// warmup, repeated samples, median/p99 ns/op, optional Linux perf_event
+// hardware counters, results as JSON
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// keeps the compiler from optimizing away a value or a computation
+template <typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+inline void clobber_memory() { asm volatile("" : : : "memory"); }
+
+// command line: --warmup N --reps N --min-time MS --filter TEXT --perf
+//               --json PATH ("-" for stdout)
+struct Config {
+    std::size_t warmup = 2;
+    std::size_t repetitions = 15;
+    double min_sample_ms = 5;
+    std::string filter{};
+    bool perf = false;
+    std::string json_path{};
+
+    static Config parse(int argc, char** argv) {
+        Config config;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--warmup" && has_value)
+                config.warmup = std::strtoull(argv[++i], nullptr, 10);
+            else if (arg == "--reps" && has_value)
+                config.repetitions = std::max<std::size_t>(
+                    1, std::strtoull(argv[++i], nullptr, 10));
+            else if (arg == "--min-time" && has_value)
+                config.min_sample_ms = std::strtod(argv[++i], nullptr);
+            else if (arg == "--filter" && has_value)
+                config.filter = argv[++i];
+            else if (arg == "--json" && has_value)
+                config.json_path = argv[++i];
+            else if (arg == "--perf")
+                config.perf = true;
+            else
+                std::cerr << "bench: ignoring argument " << arg << '\n';
+        }
+        return config;
+    }
+};
+
+// hardware counters of the calling thread, a no-op when perf_event is
+// unavailable (non-Linux, or perf_event_paranoid forbids it)
+class Perf_Counters {
+  public:
+    static constexpr std::size_t max_events = 4;
+
+  private:
+    int fds_[max_events] = {-1, -1, -1, -1};
+    const char* names_[max_events] = {"cycles", "instructions",
+                                      "branch_misses", "cache_misses"};
+    std::size_t count_ = 0;
+
+  public:
+    Perf_Counters() = default;
+    Perf_Counters(const Perf_Counters&) = delete;
+    Perf_Counters& operator=(const Perf_Counters&) = delete;
+    ~Perf_Counters() {
+#if defined(__linux__)
+        for (std::size_t i = 0; i < count_; ++i)
+            ::close(fds_[i]);
+#endif
+    }
+
+    bool open() {
+#if defined(__linux__)
+        const std::uint64_t configs[max_events] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+        for (std::size_t i = 0; i < max_events; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            long fd = ::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fd < 0)
+                break;
+            fds_[count_++] = static_cast<int>(fd);
+        }
+#endif
+        return count_ > 0;
+    }
+    std::size_t size() const { return count_; }
+    const char* name(std::size_t i) const { return names_[i]; }
+
+    void start() {
+#if defined(__linux__)
+        for (std::size_t i = 0; i < count_; ++i) {
+            ::ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    void stop(std::uint64_t* values) {
+#if defined(__linux__)
+        for (std::size_t i = 0; i < count_; ++i) {
+            ::ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (::read(fds_[i], &values[i], sizeof(values[i])) !=
+                sizeof(values[i]))
+                values[i] = 0;
+        }
+#else
+        (void) values;
+#endif
+    }
+};
+
+// statistics of one benchmark, times are per operation
+struct Result {
+    std::string name;
+    std::size_t iterations = 0; // operations per sample
+    std::vector<double> samples{}; // ns/op
+    double median = 0, p99 = 0, min = 0, mean = 0;
+    std::map<std::string, double> counters{}; // per operation
+};
+
+inline double percentile(std::vector<double> sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest rank
+    auto rank = static_cast<std::size_t>(p / 100 * sorted.size() + 0.5);
+    return sorted[std::min(sorted.size() - 1, rank ? rank - 1 : 0)];
+}
+
+// a named collection of benchmarks, each one is a callable f(n) that
+// performs n operations
+class Suite {
+    std::string name_;
+    Config config_;
+    std::vector<std::pair<std::string, std::function<void(std::size_t)>>>
+        benchmarks_{};
+    std::vector<Result> results_{};
+
+    using clock = std::chrono::steady_clock;
+
+    static double elapsed_ns(const std::function<void(std::size_t)>& f,
+                             std::size_t n) {
+        auto start = clock::now();
+        f(n);
+        clobber_memory();
+        return std::chrono::duration<double, std::nano>(clock::now() - start)
+            .count();
+    }
+
+    Result measure(const std::string& name,
+                   const std::function<void(std::size_t)>& f,
+                   Perf_Counters& perf) {
+        Result result;
+        result.name = name;
+
+        // calibrate: grow the batch until a sample takes min_sample_ms
+        std::size_t n = 1;
+        for (;;) {
+            double ns = elapsed_ns(f, n);
+            if (ns >= config_.min_sample_ms * 1e6 || n >= (1ULL << 40))
+                break;
+            double factor = ns > 0 ? config_.min_sample_ms * 1e6 / ns : 100;
+            n = static_cast<std::size_t>(
+                n * std::min(100.0, std::max(2.0, factor * 1.2)));
+        }
+        result.iterations = n;
+
+        for (std::size_t i = 0; i < config_.warmup; ++i)
+            elapsed_ns(f, n);
+
+        std::uint64_t totals[Perf_Counters::max_events] = {};
+        for (std::size_t i = 0; i < config_.repetitions; ++i) {
+            std::uint64_t values[Perf_Counters::max_events] = {};
+            perf.start();
+            double ns = elapsed_ns(f, n);
+            perf.stop(values);
+            for (std::size_t e = 0; e < perf.size(); ++e)
+                totals[e] += values[e];
+            result.samples.push_back(ns / n);
+        }
+
+        result.median = percentile(result.samples, 50);
+        result.p99 = percentile(result.samples, 99);
+        result.min =
+            *std::min_element(result.samples.begin(), result.samples.end());
+        double sum = 0;
+        for (auto sample : result.samples)
+            sum += sample;
+        result.mean = sum / result.samples.size();
+        for (std::size_t e = 0; e < perf.size(); ++e)
+            result.counters[perf.name(e)] =
+                static_cast<double>(totals[e]) / (n * config_.repetitions);
+        return result;
+    }
+
+    static std::string escape(const std::string& str) {
+        std::string out;
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+  public:
+    Suite(std::string name, int argc, char** argv)
+        : name_{std::move(name)}, config_{Config::parse(argc, argv)} {}
+
+    template <typename F>
+    void add(std::string name, F f) {
+        benchmarks_.emplace_back(std::move(name), std::move(f));
+    }
+
+    // runs every benchmark, prints a table, writes JSON if requested
+    int run() {
+        Perf_Counters perf;
+        bool perf_enabled = config_.perf && perf.open();
+        if (config_.perf && !perf_enabled)
+            std::cerr << "bench: perf_event unavailable, counters disabled\n";
+
+        std::cout << name_ << '\n';
+        for (auto&& benchmark : benchmarks_) {
+            if (benchmark.first.find(config_.filter) == std::string::npos)
+                continue;
+            results_.push_back(
+                measure(benchmark.first, benchmark.second, perf));
+            const Result& result = results_.back();
+            std::cout << "  " << std::left << std::setw(40) << result.name
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(10) << result.median << " ns/op (p99 "
+                      << result.p99 << ")";
+            for (auto&& counter : result.counters)
+                std::cout << ' ' << counter.first << '=' << counter.second;
+            std::cout << '\n';
+        }
+
+        if (config_.json_path.empty())
+            return 0;
+        if (config_.json_path == "-") {
+            write_json(std::cout);
+            return 0;
+        }
+        std::ofstream out{config_.json_path};
+        if (!out) {
+            std::cerr << "bench: cannot write " << config_.json_path << '\n';
+            return 1;
+        }
+        write_json(out);
+        return 0;
+    }
+
+    // one benchmark per line, so results diff cleanly between commits
+    void write_json(std::ostream& os) const {
+        std::ostringstream json;
+        json << std::setprecision(6);
+        json << "{\n  \"suite\": \"" << escape(name_) << "\",\n"
+             << "  \"repetitions\": " << config_.repetitions << ",\n"
+             << "  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const Result& result = results_[i];
+            json << "    {\"name\": \"" << escape(result.name)
+                 << "\", \"iterations\": " << result.iterations
+                 << ", \"median_ns\": " << result.median
+                 << ", \"p99_ns\": " << result.p99
+                 << ", \"min_ns\": " << result.min
+                 << ", \"mean_ns\": " << result.mean;
+            for (auto&& counter : result.counters)
+                json << ", \"" << counter.first << "\": " << counter.second;
+            json << '}' << (i + 1 < results_.size() ? "," : "") << '\n';
+        }
+        json << "  ]\n}\n";
+        os << json.str();
+    }
+};
+
+} // namespace bench
+
+#endif // BENCH_H_
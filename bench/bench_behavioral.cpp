@@ -0,0 +1,235 @@
+// Notification, propagation and traversal cost: Observer, Chain of
+// responsibility, Command, Iterator and State
+// the pattern classes mirror the top-level programs, minus the I/O
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <vector>
+#include "bench.h"
+
+namespace observer {
+struct IObserver {
+    virtual void notify() const = 0;
+    virtual ~IObserver() = default;
+};
+class Observer : public IObserver {
+    std::size_t _ID;
+    mutable std::size_t _count = 0;
+
+  public:
+    explicit Observer(std::size_t ID) : _ID{ID} {}
+    void notify() const override { ++_count; }
+    std::size_t ID() const { return _ID; }
+};
+class Subject {
+    std::map<std::size_t, std::shared_ptr<Observer>> _observers{};
+
+  public:
+    void registerObserver(std::shared_ptr<Observer> spo) {
+        _observers[spo->ID()] = spo;
+    }
+    void unregisterObserver(std::shared_ptr<Observer> spo) {
+        _observers.erase(spo->ID());
+    }
+    void notifyObservers() const {
+        for (auto& elem : _observers)
+            elem.second->notify();
+    }
+};
+} // namespace observer
+
+namespace chain {
+class IHandler {
+    std::shared_ptr<IHandler> next_{nullptr};
+
+  public:
+    void set_next(std::shared_ptr<IHandler> handler) { next_ = handler; }
+    std::shared_ptr<IHandler> get_next() const { return next_; }
+    virtual std::size_t handle_request(std::size_t ammount) = 0;
+    virtual ~IHandler() = default;
+};
+template <std::size_t Note>
+struct Handle : IHandler {
+    std::size_t handle_request(std::size_t ammount) override {
+        return ammount / Note + get_next()->handle_request(ammount % Note);
+    }
+};
+struct Handle_20 : IHandler {
+    std::size_t handle_request(std::size_t ammount) override {
+        return ammount / 20 + ammount % 20;
+    }
+};
+} // namespace chain
+
+namespace command {
+class IDevice {
+  protected:
+    bool is_on_ = false;
+    std::size_t volume_ = 0;
+
+  public:
+    virtual void on() = 0;
+    virtual void up() = 0;
+    virtual void down() = 0;
+    virtual ~IDevice() = default;
+    std::size_t get_volume() const { return volume_; }
+};
+class ICommand {
+  protected:
+    IDevice& device_;
+
+  public:
+    explicit ICommand(IDevice& device) : device_{device} {}
+    virtual void execute() = 0;
+    virtual void undo() = 0;
+    virtual ~ICommand() = default;
+};
+class TV : public IDevice {
+    void on() override { is_on_ = true; }
+    void up() override {
+        if (volume_ < 10)
+            ++volume_;
+    }
+    void down() override {
+        if (volume_ > 0)
+            --volume_;
+    }
+};
+class Turn_UP : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.up(); }
+    void undo() override { device_.down(); }
+};
+} // namespace command
+
+namespace iterator {
+template <typename T>
+class Collection {
+    std::vector<T> data_;
+
+    class Iterator {
+        Collection& collection_;
+        std::size_t pos_ = 0;
+
+      public:
+        Iterator(Collection& collection) : collection_{collection} {}
+        bool has_next() const { return pos_ < collection_.size(); }
+        void advance() { ++pos_; }
+        T& get() const { return collection_.data_[pos_]; }
+    };
+
+  public:
+    explicit Collection(std::size_t size) : data_(size, 1) {}
+    std::size_t size() const { return data_.size(); }
+    Iterator first() { return *this; }
+    const T* begin() const { return data_.data(); }
+    const T* end() const { return data_.data() + data_.size(); }
+};
+} // namespace iterator
+
+namespace state {
+struct IState {
+    virtual int write(class Type_Writter& type_writter, int what) = 0;
+    virtual ~IState() = default;
+};
+class Type_Writter {
+    std::unique_ptr<IState> state_;
+
+  public:
+    explicit Type_Writter(std::unique_ptr<IState> state)
+        : state_{std::move(state)} {}
+    void set_state(std::unique_ptr<IState> state) { state_ = std::move(state); }
+    int write(int what) { return state_->write(*this, what); }
+};
+struct Caps_ON : IState {
+    int write(Type_Writter&, int what) override { return what & ~0x20; }
+};
+struct Caps_OFF : IState {
+    int write(Type_Writter&, int what) override { return what | 0x20; }
+};
+} // namespace state
+
+int main(int argc, char** argv) {
+    bench::Suite suite{"behavioral", argc, argv};
+
+    // ops are single observer notifications
+    observer::Subject subject;
+    std::vector<std::shared_ptr<observer::Observer>> observers;
+    for (std::size_t i = 0; i < 1000; ++i) {
+        observers.push_back(std::make_shared<observer::Observer>(i));
+        subject.registerObserver(observers.back());
+    }
+    suite.add("observer/notify_1000", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += 1000)
+            subject.notifyObservers();
+        bench::clobber_memory();
+    });
+    suite.add("observer/register_unregister", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            subject.unregisterObserver(observers[i % 1000]);
+            subject.registerObserver(observers[i % 1000]);
+        }
+    });
+
+    auto handle_100 = std::make_shared<chain::Handle<100>>();
+    auto handle_50 = std::make_shared<chain::Handle<50>>();
+    auto handle_20 = std::make_shared<chain::Handle_20>();
+    handle_100->set_next(handle_50);
+    handle_50->set_next(handle_20);
+    std::shared_ptr<chain::IHandler> start = handle_100;
+    suite.add("chain/3_handlers", [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += start->handle_request(i);
+        bench::do_not_optimize(sum);
+    });
+
+    command::TV tv;
+    std::unique_ptr<command::ICommand> turn_up =
+        std::make_unique<command::Turn_UP>(tv);
+    suite.add("command/execute_undo", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += 2) {
+            turn_up->execute();
+            turn_up->undo();
+        }
+        bench::do_not_optimize(tv.get_volume());
+    });
+
+    iterator::Collection<int> collection(1 << 16);
+    suite.add("iterator/java_style", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; i += collection.size())
+            for (auto iter = collection.first(); iter.has_next();
+                 iter.advance())
+                sum += iter.get();
+        bench::do_not_optimize(sum);
+    });
+    suite.add("iterator/range_for", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; i += collection.size())
+            for (auto elem : collection)
+                sum += elem;
+        bench::do_not_optimize(sum);
+    });
+
+    state::Type_Writter type_writter{std::make_unique<state::Caps_OFF>()};
+    suite.add("state/write", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += type_writter.write('a' + (i & 15));
+        bench::do_not_optimize(sum);
+    });
+    suite.add("state/switch", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            if (i & 1)
+                type_writter.set_state(std::make_unique<state::Caps_ON>());
+            else
+                type_writter.set_state(std::make_unique<state::Caps_OFF>());
+        }
+        bench::clobber_memory();
+    });
+
+    return suite.run();
+}
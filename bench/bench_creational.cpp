@@ -0,0 +1,152 @@
+// Allocation and lookup cost: Factory, variadic Factory, Abstract factory
+// and Singleton
+// the pattern classes mirror the top-level programs, minus the I/O
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include "bench.h"
+
+namespace factory {
+struct IFruit {
+    virtual int get_name() const = 0;
+    virtual ~IFruit() = default;
+};
+class Apple : public IFruit {
+  public:
+    int get_name() const override { return 1; }
+};
+class BigApple : public Apple {
+  public:
+    int get_name() const override { return 2; }
+};
+class Orange : public IFruit {
+  public:
+    int get_name() const override { return 3; }
+};
+class FruitFactory {
+  public:
+    FruitFactory() = delete;
+
+    std::unique_ptr<IFruit> static make_fruit(const std::string& fruit) {
+        if (fruit == "apple")
+            return std::make_unique<Apple>();
+        else if (fruit == "big apple")
+            return std::make_unique<BigApple>();
+        else if (fruit == "orange")
+            return std::make_unique<Orange>();
+
+        return nullptr;
+    }
+};
+} // namespace factory
+
+namespace factory_variadic {
+class Factory {
+  public:
+    template <typename T, typename... Params>
+    static auto create(Params... params) {
+        return std::make_unique<T>(params...);
+    }
+};
+struct Bar {
+    Bar(bool b, double d) : value{b ? d : -d} {}
+    double value;
+};
+} // namespace factory_variadic
+
+namespace abstract_factory {
+struct IWidget {
+    virtual int draw() const = 0;
+    virtual ~IWidget() = default;
+};
+class WinButton : public IWidget {
+  public:
+    int draw() const override { return 1; }
+};
+class WinWindow : public IWidget {
+  public:
+    int draw() const override { return 2; }
+};
+struct IFactory {
+    virtual std::unique_ptr<IWidget> create_button() = 0;
+    virtual std::unique_ptr<IWidget> create_window() = 0;
+    virtual ~IFactory() = default;
+};
+class WinFactory : public IFactory {
+  public:
+    std::unique_ptr<IWidget> create_button() override {
+        return std::make_unique<WinButton>();
+    }
+    std::unique_ptr<IWidget> create_window() override {
+        return std::make_unique<WinWindow>();
+    }
+};
+} // namespace abstract_factory
+
+namespace singleton {
+template <typename T>
+class Singleton {
+  protected:
+    Singleton(const Singleton&) = delete;
+    Singleton& operator=(const Singleton&) = delete;
+    Singleton() noexcept = default;
+
+  public:
+    static T& get_instance() noexcept(std::is_nothrow_constructible<T>::value) {
+        static T instance;
+        return instance;
+    }
+};
+class Foo : public Singleton<Foo> {
+    friend class Singleton<Foo>;
+    Foo() = default;
+
+  public:
+    int value = 42;
+};
+} // namespace singleton
+
+int main(int argc, char** argv) {
+    bench::Suite suite{"creational", argc, argv};
+
+    const std::string names[] = {"apple", "big apple", "orange", "banana"};
+    suite.add("factory/make_fruit_by_name", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            auto fruit = factory::FruitFactory::make_fruit(names[i & 3]);
+            sum += fruit ? fruit->get_name() : 0;
+        }
+        bench::do_not_optimize(sum);
+    });
+
+    suite.add("factory_variadic/create", [&](std::size_t n) {
+        double sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += factory_variadic::Factory::create<factory_variadic::Bar>(
+                       i & 1, 42.5)
+                       ->value;
+        bench::do_not_optimize(sum);
+    });
+
+    std::unique_ptr<abstract_factory::IFactory> widget_factory =
+        std::make_unique<abstract_factory::WinFactory>();
+    suite.add("abstract_factory/create_button_window", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; i += 2) {
+            sum += widget_factory->create_button()->draw();
+            sum += widget_factory->create_window()->draw();
+        }
+        bench::do_not_optimize(sum);
+    });
+
+    suite.add("singleton/get_instance", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += singleton::Foo::get_instance().value;
+        bench::do_not_optimize(sum);
+    });
+
+    return suite.run();
+}
@@ -0,0 +1,218 @@
+// Dispatch cost: Visitor, double dispatching (virtual and map based),
+// Strategy and Template method
+// the pattern classes mirror the top-level programs, minus the I/O
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include "bench.h"
+
+namespace visitor {
+class IObject {
+  public:
+    virtual void accept(class IVisitor& visitor) = 0;
+    virtual ~IObject() = default;
+};
+class Car : public IObject {
+  public:
+    void accept(IVisitor& visitor) override;
+};
+class Plane : public IObject {
+  public:
+    void accept(IVisitor& visitor) override;
+};
+class Train : public IObject {
+  public:
+    void accept(IVisitor& visitor) override;
+};
+class IVisitor {
+  public:
+    virtual void visit(Car& car) = 0;
+    virtual void visit(Plane& plane) = 0;
+    virtual void visit(Train& train) = 0;
+    virtual ~IVisitor() = default;
+};
+void Car::accept(IVisitor& visitor) { visitor.visit(*this); }
+void Plane::accept(IVisitor& visitor) { visitor.visit(*this); }
+void Train::accept(IVisitor& visitor) { visitor.visit(*this); }
+
+class Counting_Visitor : public IVisitor {
+  public:
+    std::size_t cars = 0, planes = 0, trains = 0;
+    void visit(Car&) override { ++cars; }
+    void visit(Plane&) override { ++planes; }
+    void visit(Train&) override { ++trains; }
+};
+} // namespace visitor
+
+namespace double_dispatch1 {
+class Cat;
+class Dog;
+struct IAnimal {
+    virtual int play(const IAnimal&) const = 0;
+    virtual int play(const Cat&) const = 0;
+    virtual int play(const Dog&) const = 0;
+    virtual ~IAnimal() = default;
+};
+class Cat : public IAnimal {
+  public:
+    int play(const IAnimal& animal) const override {
+        return animal.play(*this); // double dispatching
+    }
+    int play(const Cat&) const override { return 1; }
+    int play(const Dog&) const override { return 2; }
+};
+class Dog : public IAnimal {
+  public:
+    int play(const IAnimal& animal) const override {
+        return animal.play(*this); // double dispatching
+    }
+    int play(const Cat&) const override { return 3; }
+    int play(const Dog&) const override { return 4; }
+};
+} // namespace double_dispatch1
+
+namespace double_dispatch2 {
+struct IAnimal {
+    virtual ~IAnimal() = default;
+};
+struct Cat : IAnimal {};
+struct Dog : IAnimal {};
+using FPTR = int (*)(const IAnimal&, const IAnimal&);
+using PLAY_MAP = std::map<std::pair<std::type_index, std::type_index>, FPTR>;
+
+int play(const PLAY_MAP& play_map, const IAnimal& first,
+         const IAnimal& second) {
+    return play_map.find({typeid(first), typeid(second)})->second(first,
+                                                                  second);
+}
+} // namespace double_dispatch2
+
+namespace strategy {
+struct IFlies {
+    virtual int fly() const = 0;
+    virtual ~IFlies() = default;
+};
+struct Flies : IFlies {
+    int fly() const override { return 1; }
+};
+struct CantFly : IFlies {
+    int fly() const override { return 0; }
+};
+} // namespace strategy
+
+namespace template_method {
+class Base {
+    virtual int f() { return 1; }
+
+  public:
+    int call() { return f() + 1; }
+    virtual ~Base() = default;
+};
+class Derived : public Base {
+    int f() override { return 2; }
+};
+} // namespace template_method
+
+int main(int argc, char** argv) {
+    bench::Suite suite{"dispatch", argc, argv};
+
+    // mixed object collection, as in visitor.cpp
+    std::vector<std::unique_ptr<visitor::IObject>> owned;
+    std::vector<std::reference_wrapper<visitor::IObject>> objects;
+    for (std::size_t i = 0; i < 1024; ++i) {
+        switch ((i * 7) % 3) {
+            case 0:
+                owned.push_back(std::make_unique<visitor::Car>());
+                break;
+            case 1:
+                owned.push_back(std::make_unique<visitor::Plane>());
+                break;
+            default:
+                owned.push_back(std::make_unique<visitor::Train>());
+        }
+        objects.emplace_back(*owned.back());
+    }
+    suite.add("visitor/accept", [&](std::size_t n) {
+        visitor::Counting_Visitor counting;
+        for (std::size_t i = 0; i < n; ++i)
+            objects[i & 1023].get().accept(counting);
+        bench::do_not_optimize(counting.cars + counting.planes);
+    });
+
+    std::unique_ptr<double_dispatch1::IAnimal> animals1[] = {
+        std::make_unique<double_dispatch1::Cat>(),
+        std::make_unique<double_dispatch1::Dog>()};
+    suite.add("double_dispatch1/virtual", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += animals1[i & 1]->play(*animals1[(i >> 1) & 1]);
+        bench::do_not_optimize(sum);
+    });
+
+    double_dispatch2::PLAY_MAP play_map;
+    auto cat_t = std::type_index(typeid(double_dispatch2::Cat));
+    auto dog_t = std::type_index(typeid(double_dispatch2::Dog));
+    play_map[{cat_t, cat_t}] = [](const double_dispatch2::IAnimal&,
+                                  const double_dispatch2::IAnimal&) {
+        return 1;
+    };
+    play_map[{cat_t, dog_t}] = [](const double_dispatch2::IAnimal&,
+                                  const double_dispatch2::IAnimal&) {
+        return 2;
+    };
+    play_map[{dog_t, cat_t}] = [](const double_dispatch2::IAnimal&,
+                                  const double_dispatch2::IAnimal&) {
+        return 3;
+    };
+    play_map[{dog_t, dog_t}] = [](const double_dispatch2::IAnimal&,
+                                  const double_dispatch2::IAnimal&) {
+        return 4;
+    };
+    std::unique_ptr<double_dispatch2::IAnimal> animals2[] = {
+        std::make_unique<double_dispatch2::Cat>(),
+        std::make_unique<double_dispatch2::Dog>()};
+    suite.add("double_dispatch2/map", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += double_dispatch2::play(play_map, *animals2[i & 1],
+                                          *animals2[(i >> 1) & 1]);
+        bench::do_not_optimize(sum);
+    });
+
+    std::unique_ptr<strategy::IFlies> strategies[] = {
+        std::make_unique<strategy::Flies>(),
+        std::make_unique<strategy::CantFly>()};
+    suite.add("strategy/call", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += strategies[(i >> 3) & 1]->fly();
+        bench::do_not_optimize(sum);
+    });
+    suite.add("strategy/swap", [&](std::size_t n) {
+        std::unique_ptr<strategy::IFlies> current;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (i & 1)
+                current = std::make_unique<strategy::Flies>();
+            else
+                current = std::make_unique<strategy::CantFly>();
+            bench::do_not_optimize(current.get());
+        }
+    });
+
+    std::unique_ptr<template_method::Base> base{
+        std::make_unique<template_method::Derived>()};
+    suite.add("template_method/nvi_call", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += base->call();
+        bench::do_not_optimize(sum);
+    });
+
+    return suite.run();
+}
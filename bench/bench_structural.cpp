@@ -0,0 +1,251 @@
+// Traversal and delegation cost: Composite, Decorator, Proxy, Bridge,
+// Adapter and Facade
+// the pattern classes mirror the top-level programs, minus the I/O
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "bench.h"
+
+namespace composite {
+struct IShape {
+    virtual void add(std::shared_ptr<IShape> elem) = 0;
+    virtual std::size_t draw() const = 0;
+    virtual ~IShape() = default;
+};
+class Circle : public IShape {
+    void add(std::shared_ptr<IShape>) override {}
+    std::size_t draw() const override { return 1; }
+};
+class Square : public IShape {
+    void add(std::shared_ptr<IShape>) override {}
+    std::size_t draw() const override { return 2; }
+};
+class Composite : public IShape {
+    std::vector<std::shared_ptr<IShape>> collection_;
+
+  public:
+    void add(std::shared_ptr<IShape> elem) override {
+        collection_.push_back(elem);
+    }
+    std::size_t draw() const override {
+        std::size_t result = 0;
+        for (auto&& elem : collection_)
+            result += elem->draw();
+        return result;
+    }
+};
+
+// full tree with the given fan-out and depth, leaves alternate
+std::shared_ptr<IShape> make_tree(std::size_t fan_out, std::size_t depth) {
+    auto root = std::make_shared<Composite>();
+    for (std::size_t i = 0; i < fan_out; ++i) {
+        if (depth > 1)
+            root->add(make_tree(fan_out, depth - 1));
+        else if (i & 1)
+            root->add(std::make_shared<Square>());
+        else
+            root->add(std::make_shared<Circle>());
+    }
+    return root;
+}
+} // namespace composite
+
+namespace decorator {
+struct IWindow {
+    virtual int draw() const = 0;
+    virtual ~IWindow() = default;
+};
+class Window : public IWindow {
+  public:
+    int draw() const override { return 1; }
+};
+class Decorator : public IWindow {
+    std::unique_ptr<IWindow> _window;
+
+  public:
+    explicit Decorator(std::unique_ptr<IWindow> window)
+        : _window{std::move(window)} {}
+    int draw() const override { return _window->draw(); }
+};
+class BorderDecorator : public Decorator {
+  public:
+    using Decorator::Decorator;
+    int draw() const override { return Decorator::draw() + 2; }
+};
+class ScrollBarDecorator : public Decorator {
+  public:
+    using Decorator::Decorator;
+    int draw() const override { return Decorator::draw() + 4; }
+};
+} // namespace decorator
+
+namespace proxy {
+struct ICar {
+    virtual int drive() const = 0;
+    virtual ~ICar() = default;
+};
+class Car : public ICar {
+  public:
+    int drive() const override { return 1; }
+};
+class Car_Proxy : public ICar {
+    std::unique_ptr<ICar> car_{std::make_unique<Car>()};
+    unsigned age_;
+
+  public:
+    explicit Car_Proxy(unsigned age) : age_{age} {}
+    int drive() const override { return age_ < 18 ? 0 : car_->drive(); }
+};
+} // namespace proxy
+
+namespace bridge {
+struct Interface {
+    virtual int A() = 0;
+    virtual ~Interface() = default;
+};
+struct Impl1 : Interface {
+    int A() override { return 1; }
+};
+class Foo {
+    std::unique_ptr<Interface> _ptr_impl;
+
+  public:
+    explicit Foo(std::unique_ptr<Interface> ptr_impl)
+        : _ptr_impl{std::move(ptr_impl)} {}
+    int A() { return _ptr_impl->A(); }
+};
+} // namespace bridge
+
+namespace adapter {
+class OldButton {
+    int _x1, _y1, _x2, _y2;
+
+  public:
+    OldButton(int x1, int y1, int x2, int y2)
+        : _x1{x1}, _y1{y1}, _x2{x2}, _y2{y2} {}
+    int draw_old() const { return _x1 + _y1 + _x2 + _y2; }
+};
+struct IButton {
+    virtual int draw() const = 0;
+    virtual ~IButton() = default;
+};
+class AdapterOldButton : public IButton, private OldButton {
+  public:
+    AdapterOldButton(int x, int y, int length, int height)
+        : OldButton(x, y, x + length, y + height) {}
+    int draw() const override { return draw_old(); }
+};
+} // namespace adapter
+
+namespace facade {
+struct Engine {
+    bool on = false;
+};
+struct Hand_Brake {
+    bool pulled = true;
+};
+struct Gear_Box {
+    int gear = 0;
+};
+struct IFacade {
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    virtual ~IFacade() = default;
+};
+class Car_Facade : public IFacade {
+    Engine engine_{};
+    Hand_Brake hand_brake_{};
+    Gear_Box gear_box_{};
+
+  public:
+    void start() override {
+        engine_.on = true;
+        hand_brake_.pulled = false;
+        gear_box_.gear = 1;
+    }
+    void stop() override {
+        gear_box_.gear = 0;
+        hand_brake_.pulled = true;
+        engine_.on = false;
+    }
+};
+} // namespace facade
+
+int main(int argc, char** argv) {
+    bench::Suite suite{"structural", argc, argv};
+
+    // 8^4 = 4096 leaves, ops are leaves visited
+    auto tree = composite::make_tree(8, 4);
+    suite.add("composite/draw_4096_leaves", [&](std::size_t n) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < n; i += 4096)
+            sum += tree->draw();
+        bench::do_not_optimize(sum);
+    });
+    suite.add("composite/build_4096_leaves", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += 4096)
+            bench::do_not_optimize(composite::make_tree(8, 4));
+    });
+
+    std::unique_ptr<decorator::IWindow> window =
+        std::make_unique<decorator::BorderDecorator>(
+            std::make_unique<decorator::BorderDecorator>(
+                std::make_unique<decorator::ScrollBarDecorator>(
+                    std::make_unique<decorator::Window>())));
+    suite.add("decorator/draw_3_layers", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += window->draw();
+        bench::do_not_optimize(sum);
+    });
+
+    std::unique_ptr<proxy::ICar> car = std::make_unique<proxy::Car>();
+    proxy::Car_Proxy car_proxy{18};
+    const proxy::ICar& proxied = car_proxy;
+    suite.add("proxy/direct", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += car->drive();
+        bench::do_not_optimize(sum);
+    });
+    suite.add("proxy/through_proxy", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += proxied.drive();
+        bench::do_not_optimize(sum);
+    });
+
+    bridge::Foo foo{std::make_unique<bridge::Impl1>()};
+    suite.add("bridge/call", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            bench::clobber_memory(); // the implementation may have changed
+            sum += foo.A();
+        }
+        bench::do_not_optimize(sum);
+    });
+
+    suite.add("adapter/make_and_draw", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            std::unique_ptr<adapter::IButton> button =
+                std::make_unique<adapter::AdapterOldButton>(i, i, 40, 10);
+            bench::do_not_optimize(button.get()); // keep the allocation
+            sum += button->draw();
+        }
+        bench::do_not_optimize(sum);
+    });
+
+    std::unique_ptr<facade::IFacade> car_facade =
+        std::make_unique<facade::Car_Facade>();
+    suite.add("facade/start_stop", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            car_facade->start();
+            car_facade->stop();
+        }
+        bench::clobber_memory();
+    });
+
+    return suite.run();
+}
@@ -0,0 +1,287 @@
+// Bridge design pattern, concurrent variant
+// the implementation can be hot-swapped while other threads call through the
+// bridge: callers never lock, swaps are published atomically and the old
+// implementation is reclaimed only after every in-flight call has finished
+// (epoch-based reclamation)
+
+// compile with
+// g++ -std=c++14 -O2 -pthread bridge_concurrent.cpp -obridge_concurrent
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct Interface {
+    virtual void A() = 0;
+    virtual void B() = 0;
+    virtual ~Interface() = default;
+};
+
+// first implementation
+struct Impl1 : Interface {
+    void A() override { std::cout << "Impl1::A()\n"; }
+
+    void B() override { std::cout << "Impl1::B()\n"; }
+};
+
+// second implementation
+struct Impl2 : Interface {
+    void A() override { std::cout << "Impl2::A()\n"; }
+
+    void B() override { std::cout << "Impl2::B()\n"; }
+};
+
+// epoch-based reclamation: readers announce the global epoch while they are
+// inside a critical section, an object retired at epoch e is deleted once no
+// reader announces an epoch <= e
+// all atomics use sequential consistency, which is what makes the announce
+// -> load / exchange -> advance orderings line up
+class Epoch_Domain {
+  public:
+    static constexpr std::size_t max_threads = 256;
+
+  private:
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> epoch{0}; // 0: not in a critical section
+        std::atomic<bool> used{false};
+    };
+
+    // per-thread slot, released when the thread exits
+    struct Registration {
+        Epoch_Domain* domain = nullptr;
+        std::size_t index = 0;
+        std::size_t depth = 0; // nested critical sections
+        ~Registration() {
+            if (domain)
+                domain->slots_[index].used = false;
+        }
+    };
+
+    std::atomic<std::uint64_t> epoch_{1};
+    Slot slots_[max_threads];
+
+    std::mutex retired_mutex_{};
+    std::vector<std::pair<std::uint64_t, std::unique_ptr<Interface>>>
+        retired_{};
+
+    Registration& registration() {
+        thread_local Registration reg;
+        if (!reg.domain) {
+            for (std::size_t i = 0; i < max_threads; ++i) {
+                bool expected = false;
+                if (slots_[i].used.compare_exchange_strong(expected, true)) {
+                    reg.domain = this;
+                    reg.index = i;
+                    return reg;
+                }
+            }
+            throw std::runtime_error("Epoch_Domain: too many threads!");
+        }
+        return reg;
+    }
+
+    // smallest epoch announced by a reader
+    std::uint64_t min_active_epoch() const {
+        std::uint64_t result = std::numeric_limits<std::uint64_t>::max();
+        for (auto&& slot : slots_) {
+            std::uint64_t epoch = slot.epoch.load();
+            if (epoch)
+                result = std::min(result, epoch);
+        }
+        return result;
+    }
+
+    void reclaim_locked() {
+        auto safe = min_active_epoch();
+        retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                      [safe](auto&& elem) {
+                                          return elem.first < safe;
+                                      }),
+                       retired_.end());
+    }
+
+    Epoch_Domain() = default;
+
+  public:
+    Epoch_Domain(const Epoch_Domain&) = delete;
+    Epoch_Domain& operator=(const Epoch_Domain&) = delete;
+
+    // one domain per process, thread registrations refer to it
+    static Epoch_Domain& get_instance() {
+        static Epoch_Domain instance;
+        return instance;
+    }
+
+    // RAII critical section, pointers loaded inside stay valid until it ends
+    class Guard {
+        Registration& reg_;
+        Slot& slot_;
+
+      public:
+        explicit Guard(Epoch_Domain& domain)
+            : reg_{domain.registration()}, slot_{domain.slots_[reg_.index]} {
+            if (reg_.depth++ == 0)
+                slot_.epoch.store(domain.epoch_.load());
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() {
+            if (--reg_.depth == 0)
+                slot_.epoch.store(0);
+        }
+    };
+
+    // takes ownership of an object that readers can no longer reach
+    void retire(std::unique_ptr<Interface> object) {
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+        retired_.emplace_back(epoch_.fetch_add(1), std::move(object));
+        reclaim_locked();
+    }
+
+    // deletes the retired objects no reader can still be using
+    void reclaim() {
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+        reclaim_locked();
+    }
+
+    std::size_t pending() {
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+        return retired_.size();
+    }
+};
+
+// concrete class that can change its interface while being used
+class Concurrent_Foo {
+    std::atomic<Interface*> _ptr_impl;
+    Epoch_Domain& _domain = Epoch_Domain::get_instance();
+
+  public:
+    explicit Concurrent_Foo(std::unique_ptr<Interface> ptr_impl)
+        : _ptr_impl{ptr_impl.release()} {}
+    Concurrent_Foo(const Concurrent_Foo&) = delete;
+    Concurrent_Foo& operator=(const Concurrent_Foo&) = delete;
+    ~Concurrent_Foo() { delete _ptr_impl.load(); } // no callers left
+
+    // publishes the new implementation, the old one is reclaimed later
+    void set_interface(std::unique_ptr<Interface> ptr_impl) {
+        std::unique_ptr<Interface> old{_ptr_impl.exchange(ptr_impl.release())};
+        _domain.retire(std::move(old));
+    }
+    void A() {
+        Epoch_Domain::Guard guard{_domain};
+        _ptr_impl.load()->A();
+    }
+    void B() {
+        Epoch_Domain::Guard guard{_domain};
+        _ptr_impl.load()->B();
+    }
+};
+
+// baseline, every call and swap take the same lock
+class Locked_Foo {
+    std::unique_ptr<Interface> _ptr_impl;
+    std::mutex _mutex{};
+
+  public:
+    explicit Locked_Foo(std::unique_ptr<Interface> ptr_impl)
+        : _ptr_impl{std::move(ptr_impl)} {}
+    void set_interface(std::unique_ptr<Interface> ptr_impl) {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _ptr_impl = std::move(ptr_impl);
+    }
+    void A() {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _ptr_impl->A();
+    }
+    void B() {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _ptr_impl->B();
+    }
+};
+
+// cheap implementation for the throughput measurement, checks that it is
+// never used after being destroyed
+struct Counting_Impl : Interface {
+    std::atomic<bool> alive{true};
+    std::atomic<std::size_t> calls{0};
+    ~Counting_Impl() override { alive = false; }
+    void A() override {
+        if (!alive)
+            std::terminate();
+        calls.fetch_add(1, std::memory_order_relaxed);
+    }
+    void B() override { A(); }
+};
+
+// callers hammer foo while one thread keeps swapping its implementation
+template <typename Foo>
+void measure(const char* name, std::size_t n_callers,
+             std::chrono::milliseconds duration) {
+    Foo foo{std::make_unique<Counting_Impl>()};
+    std::atomic<bool> stop{false};
+    std::vector<std::size_t> calls(n_callers, 0);
+    std::size_t swaps = 0;
+
+    std::vector<std::thread> callers;
+    for (std::size_t t = 0; t < n_callers; ++t)
+        callers.emplace_back([&, t] {
+            std::size_t local = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                foo.A();
+                ++local;
+            }
+            calls[t] = local;
+        });
+    std::thread swapper{[&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            foo.set_interface(std::make_unique<Counting_Impl>());
+            ++swaps;
+        }
+    }};
+
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto&& caller : callers)
+        caller.join();
+    swapper.join();
+
+    std::size_t total = 0;
+    for (auto count : calls)
+        total += count;
+    double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << name << ": " << n_callers << " caller(s), "
+              << total / seconds / 1e6 << " M calls/s, " << swaps / seconds
+              << " swaps/s\n";
+}
+
+int main() {
+    // default interface
+    Concurrent_Foo foo{std::make_unique<Impl1>()};
+    foo.A();
+    foo.B();
+
+    // "switch" the interface, safe even with concurrent callers
+    foo.set_interface(std::make_unique<Impl2>());
+    foo.A();
+    foo.B();
+
+    // call throughput during continuous swapping
+    std::size_t n_callers = std::max(4u, std::thread::hardware_concurrency());
+    auto duration = std::chrono::milliseconds{300};
+    measure<Locked_Foo>("Locked_Foo    ", n_callers, duration);
+    measure<Concurrent_Foo>("Concurrent_Foo", n_callers, duration);
+    Epoch_Domain::get_instance().reclaim();
+    std::cout << "Implementations awaiting reclamation: "
+              << Epoch_Domain::get_instance().pending() << '\n';
+}
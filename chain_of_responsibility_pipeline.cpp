@@ -0,0 +1,564 @@
+// Chain of responsibility design pattern, staged pipeline variant
+// every handler of the chain becomes a pipeline stage with its own worker
+// thread(s); stages are connected by bounded lock-free queues of request
+// batches, so a long chain works on many requests at once instead of one
+// call stack at a time
+// the handlers are the ones of chain_of_responsibility.cpp: their next
+// handler is a link that queues the request for the next stage, a handler
+// that does not call get_next() finishes the request early
+
+// compile with g++ -std=c++14 -O2 -pthread
+// chain_of_responsibility_pipeline.cpp -ochain_of_responsibility_pipeline
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// handler interface
+class IHandler {
+    std::shared_ptr<IHandler> next_{nullptr};
+
+  public:
+    void set_next(std::shared_ptr<IHandler> handler) { next_ = handler; }
+    std::shared_ptr<IHandler> get_next() const { return next_; }
+    virtual void handle_request(std::size_t ammount) = 0;
+    virtual ~IHandler() = default;
+};
+
+// concrete handlers, unchanged
+class Handle_100 : public IHandler {
+    void handle_request(std::size_t ammount) override {
+        std::size_t q = ammount / 100;
+        std::size_t r = ammount % 100;
+
+        if (q > 0) {
+            std::cout << "Dispensing: ";
+            std::cout << std::right << std::setw(10) << q << " x $100\n";
+            get_next()->handle_request(r);
+        } else {
+            get_next()->handle_request(ammount);
+        }
+    }
+};
+
+struct Handle_50 : public IHandler {
+    void handle_request(std::size_t ammount) override {
+        std::size_t q = ammount / 50;
+        std::size_t r = ammount % 50;
+
+        if (q > 0) {
+            std::cout << "Dispensing: ";
+            std::cout << std::right << std::setw(10) << q << " x $50\n";
+            get_next()->handle_request(r);
+        } else {
+            get_next()->handle_request(ammount);
+        }
+    }
+};
+
+struct Handle_20 : public IHandler {
+    void handle_request(std::size_t ammount) override {
+        std::size_t q = ammount / 20;
+        std::size_t r = ammount % 20;
+
+        if (q > 0) {
+            std::cout << "Dispensing: ";
+            std::cout << std::right << std::setw(10) << q << " x $20\n";
+        }
+        if (r > 0) {
+            std::cout << "Dispensing change: ";
+            std::cout << std::right << std::setw(3) << r << " x $1\n";
+        }
+    }
+};
+
+// requests travel between stages in batches
+struct Batch {
+    static constexpr std::size_t capacity = 64;
+    std::size_t size = 0;
+    std::size_t ammounts[capacity];
+};
+
+constexpr std::size_t Batch::capacity;
+
+// bounded queue of batches between two stages
+class IQueue {
+  public:
+    virtual bool try_push(const Batch& batch) = 0;
+    virtual bool try_pop(Batch& batch) = 0;
+    // batches in the queue, may be stale
+    virtual std::size_t size() const = 0;
+    virtual ~IQueue() = default;
+};
+
+inline std::size_t round_up_pow2(std::size_t n) {
+    std::size_t size = 2;
+    while (size < n)
+        size *= 2;
+    return size;
+}
+
+// one producer thread, one consumer thread
+class Spsc_Queue : public IQueue {
+    std::unique_ptr<Batch[]> _cells;
+    std::size_t _mask;
+    // consumer side, then producer side, each with a copy of the other
+    // side's index
+    std::atomic<std::size_t> _head{0}; // next to pop
+    std::size_t _cached_tail = 0;
+    char _padding[64]{};
+    std::atomic<std::size_t> _tail{0}; // next to push
+    std::size_t _cached_head = 0;
+
+  public:
+    explicit Spsc_Queue(std::size_t capacity)
+        : _cells{new Batch[round_up_pow2(capacity)]},
+          _mask{round_up_pow2(capacity) - 1} {}
+
+    bool try_push(const Batch& batch) override {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cached_head > _mask) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _cached_head > _mask)
+                return false;
+        }
+        _cells[tail & _mask] = batch;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(Batch& batch) override {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _cached_tail) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if (head == _cached_tail)
+                return false;
+        }
+        batch = _cells[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t size() const override {
+        return _tail.load(std::memory_order_relaxed) -
+               _head.load(std::memory_order_relaxed);
+    }
+};
+
+// any number of producers and consumers (Vyukov)
+class Mpmc_Queue : public IQueue {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        Batch batch;
+    };
+    std::unique_ptr<Cell[]> _cells;
+    std::size_t _mask;
+    std::atomic<std::size_t> _enqueue{0};
+    char _padding[64]{};
+    std::atomic<std::size_t> _dequeue{0};
+
+  public:
+    explicit Mpmc_Queue(std::size_t capacity)
+        : _cells{new Cell[round_up_pow2(capacity)]},
+          _mask{round_up_pow2(capacity) - 1} {
+        for (std::size_t i = 0; i <= _mask; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool try_push(const Batch& batch) override {
+        std::size_t pos = _enqueue.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = _cells[pos & _mask];
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+            if (sequence == pos) {
+                if (_enqueue.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed)) {
+                    cell.batch = batch;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < pos) {
+                return false; // full
+            } else {
+                pos = _enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(Batch& batch) override {
+        std::size_t pos = _dequeue.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = _cells[pos & _mask];
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+            if (sequence == pos + 1) {
+                if (_dequeue.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed)) {
+                    batch = cell.batch;
+                    cell.sequence.store(pos + _mask + 1,
+                                        std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < pos + 1) {
+                return false; // empty
+            } else {
+                pos = _dequeue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::size_t size() const override {
+        std::size_t enqueued = _enqueue.load(std::memory_order_relaxed);
+        std::size_t dequeued = _dequeue.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+};
+
+// spins, then yields the processor
+inline void backoff(std::size_t& spins) {
+    if (++spins < 64)
+        return;
+    std::this_thread::yield();
+}
+
+struct Stage_Stats {
+    std::string name;
+    std::size_t workers = 0;
+    std::size_t requests = 0;    // handled by the stage
+    std::size_t forwarded = 0;   // passed on with get_next()
+    std::size_t utilization = 0; // % of the workers' time spent in handlers
+    double mean_queue = 0;       // input batches waiting, seen by consumers
+    std::size_t max_queue = 0;
+    std::size_t queue_capacity = 0;
+    std::size_t stalls = 0; // pushes that found the next queue full
+};
+
+struct Pipeline_Options {
+    std::size_t batch = Batch::capacity; // requests per batch
+    std::size_t queue_capacity = 64;     // batches per queue
+};
+
+class Pipeline {
+  public:
+    using Handler_Factory = std::function<std::shared_ptr<IHandler>()>;
+
+  private:
+    // counters of one stage, written by its workers
+    struct Counters {
+        std::atomic<std::size_t> requests{0}, forwarded{0}, stalls{0};
+        std::atomic<std::uint64_t> busy_ns{0};
+        std::atomic<std::size_t> queue_sum{0}, queue_samples{0}, queue_max{0};
+    };
+
+    struct Stage {
+        std::string name;
+        Handler_Factory factory;
+        std::size_t workers;
+        std::unique_ptr<IQueue> input{};
+        std::unique_ptr<Counters> counters{new Counters};
+    };
+
+    // the next handler of every handler: queues the request for the next
+    // stage, or drops it behind the last one
+    class Link : public IHandler {
+        Pipeline& _pipeline;
+        IQueue* _output; // nullptr for the last stage
+        Counters& _counters;
+        Batch _batch{};
+
+      public:
+        std::size_t calls = 0;
+        Link(Pipeline& pipeline, IQueue* output, Counters& counters)
+            : _pipeline{pipeline}, _output{output}, _counters{counters} {}
+
+        void handle_request(std::size_t ammount) override {
+            ++calls;
+            if (!_output)
+                return;
+            _batch.ammounts[_batch.size++] = ammount;
+            if (_batch.size == _pipeline._options.batch)
+                flush();
+        }
+
+        void flush() {
+            if (_batch.size == 0)
+                return;
+            std::size_t spins = 0;
+            bool stalled = false;
+            while (!_output->try_push(_batch)) {
+                stalled = true;
+                backoff(spins);
+            }
+            if (stalled)
+                _counters.stalls.fetch_add(1, std::memory_order_relaxed);
+            _batch.size = 0;
+        }
+    };
+
+    Pipeline_Options _options;
+    std::vector<Stage> _stages{};
+    std::vector<std::thread> _threads{};
+    std::atomic<bool> _stop{false};
+    // requests submitted or forwarded, and not handled yet
+    std::atomic<std::int64_t> _in_flight{0};
+    Batch _pending{}; // submitted, not pushed yet
+    std::chrono::steady_clock::time_point _started{};
+
+    void work(std::size_t s) {
+        Stage& stage = _stages[s];
+        Counters& counters = *stage.counters;
+        IQueue* output = s + 1 < _stages.size() ? _stages[s + 1].input.get()
+                                                 : nullptr;
+        auto link = std::make_shared<Link>(*this, output, counters);
+        auto handler = stage.factory();
+        handler->set_next(link);
+
+        Batch batch;
+        std::size_t spins = 0;
+        for (;;) {
+            std::size_t waiting = stage.input->size();
+            if (!stage.input->try_pop(batch)) {
+                if (_stop.load(std::memory_order_acquire))
+                    return;
+                backoff(spins);
+                continue;
+            }
+            spins = 0;
+            counters.queue_sum.fetch_add(waiting, std::memory_order_relaxed);
+            counters.queue_samples.fetch_add(1, std::memory_order_relaxed);
+            if (waiting > counters.queue_max.load(std::memory_order_relaxed))
+                counters.queue_max.store(waiting, std::memory_order_relaxed);
+
+            auto start = std::chrono::steady_clock::now();
+            link->calls = 0;
+            for (std::size_t i = 0; i < batch.size; ++i)
+                handler->handle_request(batch.ammounts[i]);
+            auto busy = std::chrono::steady_clock::now() - start;
+            link->flush();
+
+            counters.busy_ns.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(busy)
+                    .count(),
+                std::memory_order_relaxed);
+            counters.requests.fetch_add(batch.size, std::memory_order_relaxed);
+            if (output)
+                counters.forwarded.fetch_add(link->calls,
+                                             std::memory_order_relaxed);
+            // forwarded requests are still in flight, the batch is not
+            _in_flight.fetch_add(
+                static_cast<std::int64_t>(output ? link->calls : 0) -
+                    static_cast<std::int64_t>(batch.size),
+                std::memory_order_acq_rel);
+        }
+    }
+
+  public:
+    explicit Pipeline(Pipeline_Options options = {}) : _options{options} {
+        _options.batch =
+            std::max<std::size_t>(1, std::min(options.batch, Batch::capacity));
+    }
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+    ~Pipeline() { stop(); }
+
+    // each worker gets its own handler from the factory
+    Pipeline& add_stage(std::string name, Handler_Factory factory,
+                        std::size_t workers = 1) {
+        if (!_threads.empty())
+            throw std::logic_error("Pipeline: already started");
+        _stages.push_back(
+            {std::move(name), std::move(factory), std::max<std::size_t>(
+                                                       1, workers)});
+        return *this;
+    }
+    template <typename Handler>
+    Pipeline& add_stage(std::string name, std::size_t workers = 1) {
+        return add_stage(
+            std::move(name), [] { return std::make_shared<Handler>(); },
+            workers);
+    }
+
+    // single producer queues where both ends have one thread
+    void start() {
+        if (!_threads.empty() || _stages.empty())
+            return;
+        for (std::size_t s = 0; s < _stages.size(); ++s) {
+            bool single_producer = s == 0 || _stages[s - 1].workers == 1;
+            if (single_producer && _stages[s].workers == 1)
+                _stages[s].input.reset(new Spsc_Queue{_options.queue_capacity});
+            else
+                _stages[s].input.reset(new Mpmc_Queue{_options.queue_capacity});
+        }
+        _started = std::chrono::steady_clock::now();
+        for (std::size_t s = 0; s < _stages.size(); ++s)
+            for (std::size_t w = 0; w < _stages[s].workers; ++w)
+                _threads.emplace_back([this, s] { work(s); });
+    }
+
+    // from one thread only
+    void submit(std::size_t ammount) {
+        _pending.ammounts[_pending.size++] = ammount;
+        _in_flight.fetch_add(1, std::memory_order_relaxed);
+        if (_pending.size == _options.batch)
+            flush();
+    }
+    void flush() {
+        if (_pending.size == 0)
+            return;
+        std::size_t spins = 0;
+        while (!_stages.front().input->try_push(_pending))
+            backoff(spins);
+        _pending.size = 0;
+    }
+    // waits until every submitted request has been handled
+    void drain() {
+        flush();
+        std::size_t spins = 0;
+        while (_in_flight.load(std::memory_order_acquire) != 0)
+            backoff(spins);
+    }
+    void stop() {
+        if (_threads.empty())
+            return;
+        drain();
+        _stop.store(true, std::memory_order_release);
+        for (auto&& thread : _threads)
+            thread.join();
+        _threads.clear();
+    }
+
+    std::vector<Stage_Stats> stats() const {
+        double elapsed_ns = std::chrono::duration<double, std::nano>(
+                                std::chrono::steady_clock::now() - _started)
+                                .count();
+        std::vector<Stage_Stats> result;
+        for (const Stage& stage : _stages) {
+            const Counters& counters = *stage.counters;
+            Stage_Stats stats;
+            stats.name = stage.name;
+            stats.workers = stage.workers;
+            stats.requests = counters.requests.load();
+            stats.forwarded = counters.forwarded.load();
+            stats.utilization = static_cast<std::size_t>(
+                100 * static_cast<double>(counters.busy_ns.load()) /
+                (elapsed_ns * static_cast<double>(stage.workers)));
+            std::size_t samples = counters.queue_samples.load();
+            stats.mean_queue = samples ? static_cast<double>(
+                                             counters.queue_sum.load()) /
+                                             static_cast<double>(samples)
+                                       : 0;
+            stats.max_queue = counters.queue_max.load();
+            stats.queue_capacity = round_up_pow2(_options.queue_capacity);
+            stats.stalls = counters.stalls.load();
+            result.push_back(stats);
+        }
+        return result;
+    }
+};
+
+// handler doing cost_ns of work, and finishing the requests divisible by
+// stop_every itself
+class Work_Handler : public IHandler {
+    std::chrono::nanoseconds _cost;
+    std::size_t _stop_every;
+
+  public:
+    Work_Handler(std::chrono::nanoseconds cost, std::size_t stop_every)
+        : _cost{cost}, _stop_every{stop_every} {}
+    void handle_request(std::size_t ammount) override {
+        auto until = std::chrono::steady_clock::now() + _cost;
+        while (std::chrono::steady_clock::now() < until)
+            ;
+        if (ammount % _stop_every != 0)
+            get_next()->handle_request(ammount);
+    }
+};
+
+int main() {
+    // one request at a time, the output matches chain_of_responsibility.cpp
+    {
+        Pipeline atm;
+        atm.add_stage<Handle_100>("100")
+            .add_stage<Handle_50>("50")
+            .add_stage<Handle_20>("20");
+        atm.start();
+        for (std::size_t ammount : {1296, 443}) {
+            std::cout << "ATM withdrawal of $" << ammount << '\n';
+            atm.submit(ammount);
+            atm.drain();
+            std::cout << '\n';
+        }
+    }
+
+    // a chain of handlers with a slow stage in the middle
+    const std::size_t n_requests = 200000;
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<std::size_t> pick(1, 1000);
+    std::vector<std::size_t> ammounts(n_requests);
+    for (auto&& elem : ammounts)
+        elem = pick(gen);
+    using std::chrono::nanoseconds;
+    auto factory = [](std::size_t cost, std::size_t stop_every) {
+        return [cost, stop_every] {
+            return std::make_shared<Work_Handler>(nanoseconds{cost},
+                                                  stop_every);
+        };
+    };
+
+    // call stack
+    auto first = factory(200, 10)(), second = factory(1000, 1000)(),
+         third = factory(200, 1)();
+    first->set_next(second);
+    second->set_next(third);
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t ammount : ammounts)
+        first->handle_request(ammount);
+    double chain_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency()
+              << "\ncall stack chain: " << std::fixed << std::setprecision(1)
+              << chain_ms << " ms\n";
+    for (std::size_t slow_workers : {1, 2}) {
+        Pipeline pipeline;
+        pipeline.add_stage("validate", factory(200, 10))
+            .add_stage("authorize", factory(1000, 1000), slow_workers)
+            .add_stage("dispense", factory(200, 1));
+        pipeline.start();
+        start = std::chrono::steady_clock::now();
+        for (std::size_t ammount : ammounts)
+            pipeline.submit(ammount);
+        pipeline.drain();
+        double pipeline_ms = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+        std::cout << "\npipeline, " << slow_workers
+                  << " authorize worker(s): " << pipeline_ms << " ms\n";
+        std::cout << std::setw(10) << "stage" << std::setw(9) << "workers"
+                  << std::setw(10) << "requests" << std::setw(11)
+                  << "forwarded" << std::setw(7) << "busy%" << std::setw(12)
+                  << "queue mean" << std::setw(11) << "queue max"
+                  << std::setw(8) << "stalls" << '\n';
+        for (const Stage_Stats& stats : pipeline.stats())
+            std::cout << std::setw(10) << stats.name << std::setw(9)
+                      << stats.workers << std::setw(10) << stats.requests
+                      << std::setw(11) << stats.forwarded << std::setw(7)
+                      << stats.utilization << std::setw(12)
+                      << stats.mean_queue << std::setw(7) << stats.max_queue
+                      << '/' << std::setw(3) << stats.queue_capacity
+                      << std::setw(8) << stats.stalls << '\n';
+    }
+}
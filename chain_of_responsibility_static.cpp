@@ -0,0 +1,255 @@
+// Chain of responsibility design pattern, statically composed variant
+// the handler sequence is a template parameter pack, so passing a request
+// down the chain inlines into straight-line code that stops at the first
+// handler reporting the request as done; a runtime configurable chain with
+// the same API covers chains only known at run time
+
+// compile with g++ -std=c++14 -O2 chain_of_responsibility_static.cpp
+// -ochain_of_responsibility_static
+
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bench/bench.h"
+
+// request, handlers fill in the notes and reduce the remaining ammount
+struct Dispense {
+    std::size_t remaining = 0;
+    std::size_t hundreds = 0, fifties = 0, twenties = 0, ones = 0;
+};
+
+// concrete handlers, no base class needed; handle_request() returns true
+// when nothing is left for the rest of the chain
+struct Handle_100 {
+    bool handle_request(Dispense& request) const {
+        request.hundreds = request.remaining / 100;
+        request.remaining %= 100;
+        return request.remaining == 0;
+    }
+};
+
+struct Handle_50 {
+    bool handle_request(Dispense& request) const {
+        request.fifties = request.remaining / 50;
+        request.remaining %= 50;
+        return request.remaining == 0;
+    }
+};
+
+struct Handle_20 {
+    bool handle_request(Dispense& request) const {
+        request.twenties = request.remaining / 20;
+        request.ones = request.remaining % 20;
+        request.remaining = 0;
+        return true;
+    }
+};
+
+// chain fixed at compile time, a request nobody finished makes
+// handle_request() return false
+template <typename... Handlers>
+class Static_Chain {
+    std::tuple<Handlers...> handlers_;
+
+    template <std::size_t I>
+    using past_end = std::integral_constant<bool, I == sizeof...(Handlers)>;
+
+    template <std::size_t I, typename Request>
+    bool handle(Request&, std::true_type) const {
+        return false;
+    }
+    template <std::size_t I, typename Request>
+    bool handle(Request& request, std::false_type) const {
+        return std::get<I>(handlers_).handle_request(request) ||
+               handle<I + 1>(request, past_end<I + 1>{});
+    }
+
+  public:
+    explicit Static_Chain(Handlers... handlers)
+        : handlers_{std::move(handlers)...} {}
+    Static_Chain() = default;
+
+    template <typename Request>
+    bool handle_request(Request& request) const {
+        return handle<0>(request, past_end<0>{});
+    }
+};
+
+// handler interface of the runtime chain
+class IHandler {
+  public:
+    virtual bool handle_request(Dispense& request) const = 0;
+    virtual ~IHandler() = default;
+};
+
+template <typename Handler>
+class Handler_Adapter : public IHandler {
+    Handler handler_;
+
+  public:
+    explicit Handler_Adapter(Handler handler) : handler_{std::move(handler)} {}
+    bool handle_request(Dispense& request) const override {
+        return handler_.handle_request(request);
+    }
+};
+
+// chain configured at run time; the handlers are owned by the chain and
+// walked by index, one virtual call per hop and no reference counting
+class Dynamic_Chain {
+    std::vector<std::unique_ptr<IHandler>> handlers_{};
+    std::size_t start_ = 0;
+
+  public:
+    template <typename Handler>
+    Dynamic_Chain& add(Handler handler) {
+        handlers_.push_back(
+            std::make_unique<Handler_Adapter<Handler>>(std::move(handler)));
+        return *this;
+    }
+    // requests enter the chain at the given handler
+    void set_start(std::size_t start) { start_ = start; }
+
+    bool handle_request(Dispense& request) const {
+        for (std::size_t i = start_; i < handlers_.size(); ++i)
+            if (handlers_[i]->handle_request(request))
+                return true;
+        return false;
+    }
+};
+
+// client, works with any chain
+template <typename Chain>
+class ATM {
+    Chain chain_;
+
+  public:
+    explicit ATM(Chain chain) : chain_{std::move(chain)} {}
+    void dispense(std::size_t ammount) const {
+        std::cout << "ATM withdrawal of $" << ammount << '\n';
+        Dispense request;
+        request.remaining = ammount;
+        if (!chain_.handle_request(request))
+            std::cout << "Cannot dispense $" << request.remaining << '\n';
+        auto print = [](std::size_t q, const char* note) {
+            if (q > 0)
+                std::cout << "Dispensing: " << std::right << std::setw(10)
+                          << q << " x $" << note << '\n';
+        };
+        print(request.hundreds, "100");
+        print(request.fifties, "50");
+        print(request.twenties, "20");
+        if (request.ones > 0)
+            std::cout << "Dispensing change: " << std::right << std::setw(3)
+                      << request.ones << " x $1\n";
+    }
+};
+
+template <typename Chain>
+ATM<Chain> make_atm(Chain chain) {
+    return ATM<Chain>{std::move(chain)};
+}
+
+// the shared_ptr linked chain of chain_of_responsibility.cpp, without the
+// output, for comparison
+namespace linked {
+class IHandler {
+    std::shared_ptr<IHandler> next_{nullptr};
+
+  public:
+    void set_next(std::shared_ptr<IHandler> handler) { next_ = handler; }
+    std::shared_ptr<IHandler> get_next() const { return next_; }
+    virtual void handle_request(Dispense& request) = 0;
+    virtual ~IHandler() = default;
+};
+
+class Handle_100 : public IHandler {
+    void handle_request(Dispense& request) override {
+        ::Handle_100{}.handle_request(request);
+        get_next()->handle_request(request);
+    }
+};
+
+class Handle_50 : public IHandler {
+    void handle_request(Dispense& request) override {
+        ::Handle_50{}.handle_request(request);
+        get_next()->handle_request(request);
+    }
+};
+
+class Handle_20 : public IHandler {
+    void handle_request(Dispense& request) override {
+        ::Handle_20{}.handle_request(request);
+    }
+};
+} // namespace linked
+
+int main(int argc, char** argv) {
+    // chain fixed at compile time
+    auto atm = make_atm(Static_Chain<Handle_100, Handle_50, Handle_20>{});
+    atm.dispense(1296);
+    std::cout << '\n';
+
+    // a shorter chain is another type
+    auto atm_50 = make_atm(Static_Chain<Handle_50, Handle_20>{});
+    atm_50.dispense(443);
+    std::cout << '\n';
+
+    // no terminal handler, the request comes back unfinished instead of
+    // following a null next
+    make_atm(Static_Chain<Handle_100, Handle_50>{}).dispense(1296);
+    std::cout << '\n';
+
+    // the same chain, configured at run time
+    Dynamic_Chain dynamic;
+    dynamic.add(Handle_100{}).add(Handle_50{}).add(Handle_20{});
+    dynamic.set_start(1);
+    make_atm(std::move(dynamic)).dispense(443);
+    std::cout << '\n';
+
+    // ops are requests
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<std::size_t> ammount(0, 2000);
+    std::vector<std::size_t> ammounts(4096);
+    for (auto&& elem : ammounts)
+        elem = ammount(gen);
+    auto run = [&](std::size_t n, auto&& handle) {
+        std::size_t notes = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            Dispense request;
+            request.remaining = ammounts[i % ammounts.size()];
+            handle(request);
+            notes += request.hundreds + request.fifties + request.twenties;
+        }
+        bench::do_not_optimize(notes);
+    };
+
+    bench::Suite suite{"chain_of_responsibility_static", argc, argv};
+    Static_Chain<Handle_100, Handle_50, Handle_20> static_chain;
+    suite.add("static_chain", [&](std::size_t n) {
+        run(n,
+            [&](Dispense& request) { static_chain.handle_request(request); });
+    });
+    Dynamic_Chain dynamic_chain;
+    dynamic_chain.add(Handle_100{}).add(Handle_50{}).add(Handle_20{});
+    suite.add("dynamic_chain", [&](std::size_t n) {
+        run(n,
+            [&](Dispense& request) { dynamic_chain.handle_request(request); });
+    });
+    auto linked_100 = std::make_shared<linked::Handle_100>();
+    auto linked_50 = std::make_shared<linked::Handle_50>();
+    auto linked_20 = std::make_shared<linked::Handle_20>();
+    linked_100->set_next(linked_50);
+    linked_50->set_next(linked_20);
+    std::shared_ptr<linked::IHandler> linked_start = linked_100;
+    suite.add("shared_ptr_chain", [&](std::size_t n) {
+        run(n,
+            [&](Dispense& request) { linked_start->handle_request(request); });
+    });
+    return suite.run();
+}
@@ -0,0 +1,636 @@
+// Command design pattern, multi-device executor
+// commands are submitted from any thread and run on a thread pool; every
+// device has a strand, a lock-free FIFO of its pending commands that at most
+// one worker drains at a time, so commands for one device run in submission
+// order while different devices run in parallel
+
+// compile with g++ -std=c++14 -O2 -pthread command_executor.cpp
+// -ocommand_executor
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// device interface (receivers)
+class IDevice {
+  protected:
+    bool is_on_ = false;
+    std::size_t volume_ = 0;
+
+  public:
+    virtual void on() = 0;
+    virtual void off() = 0;
+    virtual void up() = 0;
+    virtual void down() = 0;
+    virtual ~IDevice() = default;
+
+    bool is_on() const { return is_on_; }
+
+    std::size_t get_volume() const { return volume_; }
+};
+
+// command interface
+class ICommand {
+  protected:
+    IDevice& device_;
+
+  public:
+    ICommand(IDevice& device) : device_{device} {}
+    virtual void execute() = 0;
+    virtual void undo() = 0;
+    IDevice& device() const { return device_; }
+    virtual ~ICommand() = default;
+};
+
+// devices, every call is a round trip to the hardware
+class Remote_TV : public IDevice {
+    std::chrono::microseconds _latency;
+
+    void io() const { std::this_thread::sleep_for(_latency); }
+
+  public:
+    explicit Remote_TV(std::chrono::microseconds latency = {})
+        : _latency{latency} {}
+    void on() override {
+        io();
+        is_on_ = true;
+    }
+
+    void off() override {
+        io();
+        is_on_ = false;
+    }
+
+    void up() override {
+        io();
+        if (volume_ < 10)
+            ++volume_;
+    }
+
+    void down() override {
+        io();
+        if (volume_ > 0)
+            --volume_;
+    }
+};
+
+// commands
+class Turn_ON : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.on(); }
+
+    void undo() override { device_.off(); }
+};
+
+class Turn_OFF : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.off(); }
+
+    void undo() override { device_.on(); }
+};
+
+class Turn_UP : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.up(); }
+
+    void undo() override { device_.down(); }
+};
+
+class Turn_DOWN : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.down(); }
+
+    void undo() override { device_.up(); }
+};
+
+using Clock = std::chrono::steady_clock;
+
+// what a worker does with a submission
+enum class Action {
+    EXECUTE,  // command.execute(), remembered for undo_last()
+    UNDO,     // command.undo()
+    UNDO_LAST // undo the last remembered command of the device
+};
+
+struct Task {
+    std::atomic<Task*> next{nullptr};
+    ICommand* command = nullptr;
+    Action action = Action::EXECUTE;
+    Clock::time_point submitted{};
+};
+
+// intrusive multi-producer single-consumer FIFO (Vyukov); pop() may miss a
+// task whose push() has not finished yet
+class Task_Queue {
+    std::atomic<Task*> _head;
+    Task* _tail;
+    Task _stub{};
+
+  public:
+    Task_Queue() : _head{&_stub}, _tail{&_stub} {}
+    Task_Queue(const Task_Queue&) = delete;
+    Task_Queue& operator=(const Task_Queue&) = delete;
+
+    void push(Task* task) {
+        task->next.store(nullptr, std::memory_order_relaxed);
+        Task* prev = _head.exchange(task, std::memory_order_acq_rel);
+        prev->next.store(task, std::memory_order_release);
+    }
+
+    Task* pop() {
+        Task* tail = _tail;
+        Task* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &_stub) {
+            if (!next)
+                return nullptr;
+            _tail = tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            _tail = next;
+            return tail;
+        }
+        if (tail != _head.load(std::memory_order_acquire))
+            return nullptr; // a push is in progress
+        push(&_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            _tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+};
+
+// latency histogram, one power of two (in ns) per bucket; one writer at a
+// time, readers may look at it while it is written
+class Latency_Histogram {
+    std::atomic<std::uint64_t> _buckets[64] = {};
+    std::atomic<std::uint64_t> _count{0}, _total_ns{0}, _max_ns{0};
+
+    static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by,
+                      std::memory_order_relaxed);
+    }
+
+  public:
+    void record(std::uint64_t ns) {
+        std::size_t bucket = 0;
+        while (bucket < 63 && (std::uint64_t{1} << (bucket + 1)) <= ns)
+            ++bucket;
+        bump(_buckets[bucket], 1);
+        bump(_count, 1);
+        bump(_total_ns, ns);
+        if (ns > _max_ns.load(std::memory_order_relaxed))
+            _max_ns.store(ns, std::memory_order_relaxed);
+    }
+    std::uint64_t count() const {
+        return _count.load(std::memory_order_relaxed);
+    }
+    double mean_ns() const {
+        std::uint64_t n = count();
+        return n ? static_cast<double>(
+                       _total_ns.load(std::memory_order_relaxed)) /
+                       static_cast<double>(n)
+                 : 0;
+    }
+    std::uint64_t max_ns() const {
+        return _max_ns.load(std::memory_order_relaxed);
+    }
+    // upper bound of the bucket holding the q-th quantile
+    std::uint64_t quantile_ns(double q) const {
+        std::uint64_t n = count(), seen = 0;
+        if (n == 0)
+            return 0;
+        auto rank = static_cast<std::uint64_t>(q * static_cast<double>(n));
+        for (std::size_t bucket = 0; bucket < 64; ++bucket) {
+            seen += _buckets[bucket].load(std::memory_order_relaxed);
+            if (seen > rank)
+                return std::min(max_ns(), (std::uint64_t{2} << bucket) - 1);
+        }
+        return max_ns();
+    }
+};
+
+struct Device_Stats {
+    std::size_t queue_depth = 0;     // submitted, not yet completed
+    std::size_t max_queue_depth = 0;
+    std::size_t completed = 0;
+    std::size_t failed = 0;          // commands that threw
+    double mean_latency_us = 0;      // submission to completion
+    double p99_latency_us = 0;
+    double max_latency_us = 0;
+};
+
+// pending commands of one device
+class Strand {
+    friend class Command_Executor;
+
+    Task_Queue _queue{};
+    // submissions not completed yet; the submission taking it from 0 to 1
+    // schedules the strand, the completion taking it back to 0 retires it,
+    // so at most one worker runs the strand
+    std::atomic<std::size_t> _pending{0};
+    std::atomic<std::size_t> _max_pending{0};
+    std::atomic<std::size_t> _failed{0};
+    Latency_Histogram _latency{};
+    // executed commands, only touched by the worker running the strand
+    std::vector<ICommand*> _history{};
+
+    Strand() = default;
+
+    // true if the strand was scheduled and must be handed to a worker
+    bool enqueue(Task* task) {
+        // count first, so a worker never retires the strand with the task
+        // still on its way
+        std::size_t depth = _pending.fetch_add(1, std::memory_order_acq_rel);
+        std::size_t max = _max_pending.load(std::memory_order_relaxed);
+        while (depth + 1 > max &&
+               !_max_pending.compare_exchange_weak(max, depth + 1,
+                                                   std::memory_order_relaxed))
+            ;
+        _queue.push(task);
+        return depth == 0;
+    }
+
+    void run_task(Task* task) {
+        try {
+            switch (task->action) {
+                case Action::EXECUTE:
+                    task->command->execute();
+                    _history.push_back(task->command);
+                    break;
+                case Action::UNDO:
+                    task->command->undo();
+                    break;
+                case Action::UNDO_LAST:
+                    if (!_history.empty()) {
+                        _history.back()->undo();
+                        _history.pop_back();
+                    }
+                    break;
+            }
+        } catch (...) {
+            _failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        _latency.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - task->submitted)
+                .count()));
+        delete task;
+    }
+
+    // runs up to budget commands, true if the strand is still scheduled
+    bool run(std::size_t budget) {
+        for (std::size_t i = 0; i < budget; ++i) {
+            Task* task = _queue.pop();
+            if (!task) // counted but not pushed yet, come back later
+                return true;
+            run_task(task);
+            if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                return false;
+        }
+        return true;
+    }
+
+  public:
+    Device_Stats stats() const {
+        Device_Stats stats;
+        stats.queue_depth = _pending.load(std::memory_order_relaxed);
+        stats.max_queue_depth = _max_pending.load(std::memory_order_relaxed);
+        stats.completed = _latency.count();
+        stats.failed = _failed.load(std::memory_order_relaxed);
+        stats.mean_latency_us = _latency.mean_ns() / 1000;
+        stats.p99_latency_us =
+            static_cast<double>(_latency.quantile_ns(0.99)) / 1000;
+        stats.max_latency_us = static_cast<double>(_latency.max_ns()) / 1000;
+        return stats;
+    }
+};
+
+// bounded multi-producer multi-consumer queue of scheduled strands (Vyukov);
+// a strand is in it at most once, so one slot per strand never overflows
+class Ready_Queue {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        Strand* strand;
+    };
+    std::unique_ptr<Cell[]> _cells;
+    std::size_t _mask;
+    alignas(64) std::atomic<std::size_t> _enqueue{0};
+    alignas(64) std::atomic<std::size_t> _dequeue{0};
+
+  public:
+    explicit Ready_Queue(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        _cells.reset(new Cell[size]);
+        _mask = size - 1;
+        for (std::size_t i = 0; i < size; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    void push(Strand* strand) {
+        std::size_t pos = _enqueue.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = _cells[pos & _mask];
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+            if (sequence == pos) {
+                if (_enqueue.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed)) {
+                    cell.strand = strand;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return;
+                }
+            } else {
+                // cannot be full, the cell is about to be released
+                pos = _enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Strand* pop() {
+        std::size_t pos = _dequeue.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = _cells[pos & _mask];
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+            if (sequence == pos + 1) {
+                if (_dequeue.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed)) {
+                    Strand* strand = cell.strand;
+                    cell.sequence.store(pos + _mask + 1,
+                                        std::memory_order_release);
+                    return strand;
+                }
+            } else if (sequence < pos + 1) {
+                return nullptr; // empty
+            } else {
+                pos = _dequeue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// runs commands on a thread pool, in order per device
+// the set of devices is fixed at construction, so looking up a strand needs
+// no lock; submissions for other devices throw std::out_of_range
+class Command_Executor {
+    std::vector<std::unique_ptr<Strand>> _strands{};
+    std::unordered_map<const IDevice*, Strand*> _by_device{};
+    Ready_Queue _ready;
+    std::vector<std::thread> _workers{};
+    std::atomic<bool> _stop{false};
+    std::atomic<std::size_t> _in_flight{0}; // submitted, not completed
+    // idle workers sleep here; only touched when a worker ran out of work
+    std::mutex _idle_mutex{};
+    std::condition_variable _idle{};
+    std::atomic<std::size_t> _sleepers{0};
+
+    static constexpr std::size_t budget = 32; // commands per strand visit
+
+    Strand& strand(const IDevice& device) const {
+        auto it = _by_device.find(&device);
+        if (it == _by_device.end())
+            throw std::out_of_range("Command_Executor: unknown device");
+        return *it->second;
+    }
+
+    void submit(ICommand* command, const IDevice& device, Action action) {
+        Strand& target = strand(device);
+        auto* task = new Task;
+        task->command = command;
+        task->action = action;
+        task->submitted = Clock::now();
+        _in_flight.fetch_add(1, std::memory_order_relaxed);
+        if (target.enqueue(task))
+            schedule(target);
+    }
+
+    void schedule(Strand& strand) {
+        _ready.push(&strand);
+        if (_sleepers.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock{_idle_mutex};
+            _idle.notify_one();
+        }
+    }
+
+    void work() {
+        std::size_t idle_spins = 0;
+        while (!_stop.load(std::memory_order_acquire)) {
+            if (Strand* strand = _ready.pop()) {
+                idle_spins = 0;
+                std::size_t before = strand->_latency.count();
+                bool again = strand->run(budget);
+                _in_flight.fetch_sub(strand->_latency.count() - before,
+                                     std::memory_order_release);
+                if (again)
+                    _ready.push(strand);
+                continue;
+            }
+            if (++idle_spins < 64) {
+                std::this_thread::yield();
+                continue;
+            }
+            // the timeout covers a wake-up racing with going to sleep
+            std::unique_lock<std::mutex> lock{_idle_mutex};
+            _sleepers.fetch_add(1, std::memory_order_seq_cst);
+            _idle.wait_for(lock, std::chrono::milliseconds{1});
+            _sleepers.fetch_sub(1, std::memory_order_relaxed);
+            idle_spins = 0;
+        }
+    }
+
+  public:
+    Command_Executor(const std::vector<IDevice*>& devices,
+                     std::size_t threads = std::max(
+                         1u, std::thread::hardware_concurrency()))
+        : _ready{devices.size()} {
+        for (IDevice* device : devices) {
+            if (_by_device.count(device))
+                continue;
+            _strands.emplace_back(new Strand);
+            _by_device[device] = _strands.back().get();
+        }
+        for (std::size_t i = 0; i < std::max<std::size_t>(1, threads); ++i)
+            _workers.emplace_back([this] { work(); });
+    }
+    Command_Executor(const Command_Executor&) = delete;
+    Command_Executor& operator=(const Command_Executor&) = delete;
+
+    // finishes every submitted command
+    ~Command_Executor() {
+        drain();
+        _stop.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock{_idle_mutex};
+            _idle.notify_all();
+        }
+        for (auto&& worker : _workers)
+            worker.join();
+    }
+
+    // thread safe; commands of one device run in the order they were
+    // submitted (from one thread, or as ordered between threads)
+    void execute(ICommand& command) {
+        submit(&command, command.device(), Action::EXECUTE);
+    }
+    void undo(ICommand& command) {
+        submit(&command, command.device(), Action::UNDO);
+    }
+    // undoes the most recent command of the device executed through
+    // execute() and not undone yet, after everything submitted before
+    void undo_last(const IDevice& device) {
+        submit(nullptr, device, Action::UNDO_LAST);
+    }
+
+    // waits until every command submitted so far has completed
+    void drain() const {
+        while (_in_flight.load(std::memory_order_acquire) != 0)
+            std::this_thread::sleep_for(std::chrono::microseconds{50});
+    }
+
+    Device_Stats stats(const IDevice& device) const {
+        return strand(device).stats();
+    }
+};
+
+int main() {
+    const std::size_t n_devices = 1000, n_producers = 4;
+    const std::size_t commands_per_device = 40;
+    const auto latency = std::chrono::microseconds{50};
+
+    // the same random scripts run serially and through the executor; every
+    // device gets its commands from one producer, so the end states match
+    struct Step {
+        std::size_t command; // index into the device's commands
+        Action action;
+    };
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> pick(0, 19);
+    std::vector<std::vector<Step>> scripts(n_devices);
+    for (auto&& script : scripts)
+        for (std::size_t i = 0; i < commands_per_device; ++i) {
+            int r = pick(gen);
+            Action action = r == 0   ? Action::UNDO_LAST
+                            : r == 1 ? Action::UNDO
+                                     : Action::EXECUTE;
+            script.push_back({static_cast<std::size_t>(pick(gen) % 4), action});
+        }
+
+    struct Rig {
+        std::vector<std::unique_ptr<Remote_TV>> devices;
+        std::vector<std::vector<std::unique_ptr<ICommand>>> commands;
+    };
+    auto make_rig = [&] {
+        Rig rig;
+        for (std::size_t d = 0; d < n_devices; ++d) {
+            rig.devices.push_back(std::make_unique<Remote_TV>(latency));
+            IDevice& tv = *rig.devices.back();
+            std::vector<std::unique_ptr<ICommand>> commands;
+            commands.push_back(std::make_unique<Turn_ON>(tv));
+            commands.push_back(std::make_unique<Turn_OFF>(tv));
+            commands.push_back(std::make_unique<Turn_UP>(tv));
+            commands.push_back(std::make_unique<Turn_DOWN>(tv));
+            rig.commands.push_back(std::move(commands));
+        }
+        return rig;
+    };
+
+    // serially, on the caller's thread as in command.cpp
+    Rig serial = make_rig();
+    auto start = Clock::now();
+    for (std::size_t d = 0; d < n_devices; ++d) {
+        std::vector<ICommand*> history;
+        for (const Step& step : scripts[d]) {
+            ICommand& command = *serial.commands[d][step.command];
+            if (step.action == Action::EXECUTE) {
+                command.execute();
+                history.push_back(&command);
+            } else if (step.action == Action::UNDO) {
+                command.undo();
+            } else if (!history.empty()) {
+                history.back()->undo();
+                history.pop_back();
+            }
+        }
+    }
+    double serial_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    // through the executor, submitted from several threads
+    Rig parallel = make_rig();
+    std::vector<IDevice*> devices;
+    for (auto&& device : parallel.devices)
+        devices.push_back(device.get());
+    Command_Executor executor{devices, 64};
+    start = Clock::now();
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < n_producers; ++p)
+        producers.emplace_back([&, p] {
+            // interleave the devices of this producer
+            for (std::size_t i = 0; i < commands_per_device; ++i)
+                for (std::size_t d = p; d < n_devices; d += n_producers) {
+                    const Step& step = scripts[d][i];
+                    ICommand& command = *parallel.commands[d][step.command];
+                    if (step.action == Action::EXECUTE)
+                        executor.execute(command);
+                    else if (step.action == Action::UNDO)
+                        executor.undo(command);
+                    else
+                        executor.undo_last(*parallel.devices[d]);
+                }
+        });
+    for (auto&& producer : producers)
+        producer.join();
+    executor.drain();
+    double parallel_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::size_t mismatches = 0;
+    for (std::size_t d = 0; d < n_devices; ++d)
+        if (serial.devices[d]->is_on() != parallel.devices[d]->is_on() ||
+            serial.devices[d]->get_volume() !=
+                parallel.devices[d]->get_volume())
+            ++mismatches;
+
+    std::cout << n_devices * commands_per_device << " commands on "
+              << n_devices << " devices, " << latency.count()
+              << " us per device call\n";
+    std::cout << std::fixed << std::setprecision(1)
+              << "Serial:   " << serial_ms << " ms\n"
+              << "Executor: " << parallel_ms << " ms\n"
+              << "Devices whose end state differs: " << mismatches << "\n\n";
+
+    std::cout << std::setw(8) << "device" << std::setw(10) << "completed"
+              << std::setw(8) << "depth" << std::setw(10) << "max depth"
+              << std::setw(12) << "mean us" << std::setw(12) << "p99 us"
+              << std::setw(12) << "max us" << '\n';
+    for (std::size_t d = 0; d < 5; ++d) {
+        Device_Stats stats = executor.stats(*parallel.devices[d]);
+        std::cout << std::setw(8) << d << std::setw(10) << stats.completed
+                  << std::setw(8) << stats.queue_depth << std::setw(10)
+                  << stats.max_queue_depth << std::setw(12)
+                  << stats.mean_latency_us << std::setw(12)
+                  << stats.p99_latency_us << std::setw(12)
+                  << stats.max_latency_us << '\n';
+    }
+}
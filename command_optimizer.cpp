@@ -0,0 +1,488 @@
+// Command design pattern, optimizing command batches
+// a batch of commands is compiled before it runs: peephole passes cancel
+// execute/undo pairs, merge runs of volume steps into one clamped change and
+// collapse runs of on/off switches, so the devices see fewer calls with the
+// same end result
+
+// compile with g++ -std=c++14 -O2 command_optimizer.cpp -ocommand_optimizer
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// device interface (receivers)
+class IDevice {
+  protected:
+    bool is_on_ = false;
+    std::size_t volume_ = 0;
+    std::size_t channel_ = 0;
+
+  public:
+    static constexpr std::size_t max_volume = 10;
+    static constexpr std::size_t channels = 8;
+
+    virtual void on() = 0;
+    virtual void off() = 0;
+    virtual void up() = 0;
+    virtual void down() = 0;
+    virtual void next_channel() = 0;
+    virtual void previous_channel() = 0;
+    // one call instead of a series of up()/down()
+    virtual void set_volume(std::size_t volume) {
+        volume = std::min(volume, max_volume);
+        while (volume_ < volume)
+            up();
+        while (volume_ > volume)
+            down();
+    }
+    virtual ~IDevice() = default;
+
+    bool is_on() const { return is_on_; }
+
+    std::size_t get_volume() const { return volume_; }
+
+    std::size_t get_channel() const { return channel_; }
+};
+
+constexpr std::size_t IDevice::max_volume;
+constexpr std::size_t IDevice::channels;
+
+enum class Action { EXECUTE, UNDO };
+
+// what a command does to its device, as far as the optimizer understands it
+struct Effect {
+    enum Kind { OPAQUE, POWER, VOLUME_STEP } kind = OPAQUE;
+    bool on = false; // POWER: the device is switched on (or off)
+    int step = 0;    // VOLUME_STEP: +1 or -1, clamped by the device
+};
+
+// command interface
+class ICommand {
+  protected:
+    IDevice& device_;
+
+  public:
+    ICommand(IDevice& device) : device_{device} {}
+    virtual void execute() = 0;
+    virtual void undo() = 0;
+    virtual Effect effect(Action) const { return {}; }
+    // undo() restores the state before execute() in every state, and the
+    // other way around
+    virtual bool exact_undo() const { return false; }
+    IDevice& device() const { return device_; }
+    virtual ~ICommand() = default;
+};
+
+// devices
+class TV : public IDevice {
+    void on() override {
+        is_on_ = true;
+        std::cout << "TV is ON\n";
+    }
+
+    void off() override {
+        is_on_ = false;
+        std::cout << "TV is OFF\n";
+    }
+
+    void up() override {
+        if (volume_ < max_volume)
+            ++volume_;
+        std::cout << "Turning volume up to   " << volume_ << '\n';
+    }
+
+    void down() override {
+        if (volume_ > 0)
+            --volume_;
+        std::cout << "Turning volume down to " << volume_ << '\n';
+    }
+
+    void next_channel() override {
+        channel_ = (channel_ + 1) % channels;
+        std::cout << "Switching to channel   " << channel_ << '\n';
+    }
+
+    void previous_channel() override {
+        channel_ = (channel_ + channels - 1) % channels;
+        std::cout << "Switching to channel   " << channel_ << '\n';
+    }
+
+    void set_volume(std::size_t volume) override {
+        volume_ = std::min(volume, max_volume);
+        std::cout << "Setting volume to      " << volume_ << '\n';
+    }
+};
+
+// commands
+class Turn_ON : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.on(); }
+
+    void undo() override { device_.off(); }
+
+    Effect effect(Action action) const override {
+        return {Effect::POWER, action == Action::EXECUTE, 0};
+    }
+};
+
+class Turn_OFF : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.off(); }
+
+    void undo() override { device_.on(); }
+
+    Effect effect(Action action) const override {
+        return {Effect::POWER, action == Action::UNDO, 0};
+    }
+};
+
+class Turn_UP : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.up(); }
+
+    void undo() override { device_.down(); }
+
+    Effect effect(Action action) const override {
+        return {Effect::VOLUME_STEP, false,
+                action == Action::EXECUTE ? 1 : -1};
+    }
+};
+
+class Turn_DOWN : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.down(); }
+
+    void undo() override { device_.up(); }
+
+    Effect effect(Action action) const override {
+        return {Effect::VOLUME_STEP, false,
+                action == Action::EXECUTE ? -1 : 1};
+    }
+};
+
+// channels wrap around, so undo is exact (unlike the clamped volume)
+class Next_Channel : public ICommand {
+  public:
+    using ICommand::ICommand;
+    void execute() override { device_.next_channel(); }
+
+    void undo() override { device_.previous_channel(); }
+
+    bool exact_undo() const override { return true; }
+};
+
+// one step of a compiled batch
+struct Op {
+    enum Kind { CALL, POWER, VOLUME } kind;
+    IDevice* device;
+    // CALL: the original command
+    ICommand* command;
+    Action action;
+    // POWER: switch on or off
+    bool on;
+    // VOLUME: v -> clamp(v + delta, low, high), the composition of any
+    // number of clamped steps has this form
+    int delta, low, high;
+
+    static Op call(ICommand& command, Action action) {
+        return {CALL, &command.device(), &command, action, false, 0, 0, 0};
+    }
+};
+
+struct Optimizer_Stats {
+    std::size_t commands = 0;
+    std::size_t cancelled_pairs = 0;
+    std::size_t merged_volume_steps = 0;
+    std::size_t collapsed_power_switches = 0;
+    std::size_t ops = 0;
+};
+
+// peephole passes, each one preserves the end state of every device
+namespace passes {
+// execute(c) next to undo(c) does nothing if c's undo is exact
+std::vector<Op> cancel_undo_pairs(const std::vector<Op>& in,
+                                  Optimizer_Stats& stats) {
+    std::vector<Op> out;
+    for (const Op& op : in) {
+        if (!out.empty() && op.kind == Op::CALL &&
+            out.back().kind == Op::CALL && out.back().command == op.command &&
+            out.back().action != op.action && op.command->exact_undo()) {
+            out.pop_back();
+            ++stats.cancelled_pairs;
+            continue;
+        }
+        out.push_back(op);
+    }
+    return out;
+}
+
+// commands the optimizer understands become POWER and VOLUME ops
+std::vector<Op> lower(const std::vector<Op>& in) {
+    std::vector<Op> out;
+    for (const Op& op : in) {
+        Effect effect = op.kind == Op::CALL ? op.command->effect(op.action)
+                                            : Effect{};
+        Op lowered = op;
+        if (effect.kind == Effect::POWER) {
+            lowered.kind = Op::POWER;
+            lowered.on = effect.on;
+        } else if (effect.kind == Effect::VOLUME_STEP) {
+            lowered.kind = Op::VOLUME;
+            lowered.delta = effect.step;
+            lowered.low = 0;
+            lowered.high = static_cast<int>(IDevice::max_volume);
+        }
+        out.push_back(lowered);
+    }
+    return out;
+}
+
+// adjacent volume changes of one device compose into one
+std::vector<Op> merge_volume_steps(const std::vector<Op>& in,
+                                   Optimizer_Stats& stats) {
+    auto clamp = [](int v, int low, int high) {
+        return std::max(low, std::min(v, high));
+    };
+    std::vector<Op> out;
+    for (const Op& op : in) {
+        if (!out.empty() && op.kind == Op::VOLUME &&
+            out.back().kind == Op::VOLUME && out.back().device == op.device) {
+            // clamp(clamp(v + a, l, h) + b, L, H)
+            //   = clamp(v + a + b, clamp(l + b, L, H), clamp(h + b, L, H))
+            Op& prev = out.back();
+            prev.low = clamp(prev.low + op.delta, op.low, op.high);
+            prev.high = clamp(prev.high + op.delta, op.low, op.high);
+            prev.delta += op.delta;
+            ++stats.merged_volume_steps;
+            continue;
+        }
+        out.push_back(op);
+    }
+    return out;
+}
+
+// of adjacent on/off switches of one device only the last one matters
+std::vector<Op> collapse_power_switches(const std::vector<Op>& in,
+                                        Optimizer_Stats& stats) {
+    std::vector<Op> out;
+    for (const Op& op : in) {
+        if (!out.empty() && op.kind == Op::POWER &&
+            out.back().kind == Op::POWER && out.back().device == op.device) {
+            out.back() = op;
+            ++stats.collapsed_power_switches;
+            continue;
+        }
+        out.push_back(op);
+    }
+    return out;
+}
+} // namespace passes
+
+// an optimized batch, reads the device state when it runs and skips calls
+// that would not change it
+class Compiled_Batch {
+    std::vector<Op> _ops;
+
+  public:
+    explicit Compiled_Batch(std::vector<Op> ops) : _ops{std::move(ops)} {}
+    std::size_t size() const { return _ops.size(); }
+
+    void run() const {
+        for (const Op& op : _ops) {
+            switch (op.kind) {
+                case Op::CALL:
+                    if (op.action == Action::EXECUTE)
+                        op.command->execute();
+                    else
+                        op.command->undo();
+                    break;
+                case Op::POWER:
+                    if (op.device->is_on() != op.on) {
+                        if (op.on)
+                            op.device->on();
+                        else
+                            op.device->off();
+                    }
+                    break;
+                case Op::VOLUME: {
+                    int volume = static_cast<int>(op.device->get_volume());
+                    int target = std::max(
+                        op.low, std::min(volume + op.delta, op.high));
+                    if (target != volume)
+                        op.device->set_volume(static_cast<std::size_t>(target));
+                    break;
+                }
+            }
+        }
+    }
+};
+
+// records commands, runs them as they are or compiled
+class Command_Batch {
+    std::vector<Op> _commands{};
+
+  public:
+    Command_Batch& execute(ICommand& command) {
+        _commands.push_back(Op::call(command, Action::EXECUTE));
+        return *this;
+    }
+    Command_Batch& undo(ICommand& command) {
+        _commands.push_back(Op::call(command, Action::UNDO));
+        return *this;
+    }
+    std::size_t size() const { return _commands.size(); }
+
+    void run() const { Compiled_Batch{_commands}.run(); }
+
+    Compiled_Batch compile(Optimizer_Stats& stats) const {
+        stats = Optimizer_Stats{};
+        stats.commands = _commands.size();
+        auto ops = passes::cancel_undo_pairs(_commands, stats);
+        ops = passes::lower(ops);
+        ops = passes::merge_volume_steps(ops, stats);
+        ops = passes::collapse_power_switches(ops, stats);
+        stats.ops = ops.size();
+        return Compiled_Batch{std::move(ops)};
+    }
+    Compiled_Batch compile() const {
+        Optimizer_Stats stats;
+        return compile(stats);
+    }
+};
+
+// device whose every call costs a round trip, counts the calls
+class Remote_Device : public IDevice {
+    std::chrono::microseconds _latency;
+
+    void io() {
+        ++calls;
+        std::this_thread::sleep_for(_latency);
+    }
+
+  public:
+    std::size_t calls = 0;
+    explicit Remote_Device(std::chrono::microseconds latency)
+        : _latency{latency} {}
+    void on() override {
+        io();
+        is_on_ = true;
+    }
+    void off() override {
+        io();
+        is_on_ = false;
+    }
+    void up() override {
+        io();
+        volume_ = std::min(volume_ + 1, max_volume);
+    }
+    void down() override {
+        io();
+        volume_ = volume_ ? volume_ - 1 : 0;
+    }
+    void next_channel() override {
+        io();
+        channel_ = (channel_ + 1) % channels;
+    }
+    void previous_channel() override {
+        io();
+        channel_ = (channel_ + channels - 1) % channels;
+    }
+    void set_volume(std::size_t volume) override {
+        io();
+        volume_ = std::min(volume, max_volume);
+    }
+};
+
+int main() {
+    TV tv; // a concrete device
+
+    // some commands
+    Turn_ON turn_on(tv);
+    Turn_OFF turn_off(tv);
+    Turn_UP turn_up(tv);
+    Turn_DOWN turn_down(tv);
+    Next_Channel next_channel(tv);
+
+    // the sequence of command.cpp, as one batch
+    Command_Batch batch;
+    batch.execute(turn_on).execute(turn_off).undo(turn_off);
+    batch.execute(turn_up).execute(turn_up).execute(turn_down);
+    batch.undo(turn_up).undo(turn_up);
+    batch.execute(next_channel).undo(next_channel);
+    for (std::size_t i = 0; i < 12; ++i)
+        batch.execute(turn_up);
+    batch.execute(turn_off);
+
+    Optimizer_Stats stats;
+    Compiled_Batch compiled = batch.compile(stats);
+    std::cout << stats.commands << " commands compiled to " << stats.ops
+              << " ops (" << stats.cancelled_pairs << " pairs cancelled, "
+              << stats.merged_volume_steps << " volume steps merged, "
+              << stats.collapsed_power_switches
+              << " power switches collapsed)\n";
+    compiled.run();
+    std::cout << "Is the TV ON? " << std::boolalpha << tv.is_on() << '\n';
+    std::cout << "Final TV volume: " << tv.get_volume() << "\n\n";
+
+    // random streams against devices with a per-call cost, the naive and
+    // the compiled run must end in the same state
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> pick(0, 9);
+    const std::size_t n_commands = 2000;
+    auto latency = std::chrono::microseconds{20};
+    Remote_Device naive_device{latency}, compiled_device{latency};
+    auto make_commands = [](IDevice& device) {
+        std::vector<std::unique_ptr<ICommand>> commands;
+        commands.push_back(std::make_unique<Turn_ON>(device));
+        commands.push_back(std::make_unique<Turn_OFF>(device));
+        commands.push_back(std::make_unique<Turn_UP>(device));
+        commands.push_back(std::make_unique<Turn_DOWN>(device));
+        commands.push_back(std::make_unique<Next_Channel>(device));
+        return commands;
+    };
+    auto naive_commands = make_commands(naive_device);
+    auto compiled_commands = make_commands(compiled_device);
+    Command_Batch naive_batch, compiled_batch;
+    for (std::size_t i = 0; i < n_commands; ++i) {
+        // mostly volume steps, as from a held remote button
+        int r = pick(gen);
+        std::size_t which = r < 4 ? 2 : r < 7 ? 3 : r < 8 ? 4 : r % 2;
+        bool undo = pick(gen) == 0;
+        if (undo) {
+            naive_batch.undo(*naive_commands[which]);
+            compiled_batch.undo(*compiled_commands[which]);
+        } else {
+            naive_batch.execute(*naive_commands[which]);
+            compiled_batch.execute(*compiled_commands[which]);
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    naive_batch.run();
+    double naive_ms =
+        std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    start = clock::now();
+    compiled_batch.compile(stats).run();
+    double compiled_ms =
+        std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    std::cout << "Naive:    " << naive_device.calls << " device calls, "
+              << naive_ms << " ms\n";
+    std::cout << "Compiled: " << compiled_device.calls << " device calls, "
+              << compiled_ms << " ms (" << stats.ops << " ops)\n";
+    std::cout << "Same end state? "
+              << (naive_device.is_on() == compiled_device.is_on() &&
+                  naive_device.get_volume() == compiled_device.get_volume() &&
+                  naive_device.get_channel() == compiled_device.get_channel())
+              << '\n';
+}
@@ -0,0 +1,325 @@
+// Composite design pattern, incremental redraw
+// every shape caches what it rendered last; a change marks the shape and
+// all its ancestors dirty, and the next frame recomputes only the dirty
+// shapes, reusing the cache everywhere else (also for subtrees shared by
+// several composites), so the cost of a frame follows what changed instead
+// of the size of the scene
+
+// compile with g++ -std=c++14 -O2 composite_incremental.cpp
+// -ocomposite_incremental
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench/bench.h"
+
+struct Bounds {
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = std::numeric_limits<double>::infinity();
+    double max_x = -std::numeric_limits<double>::infinity();
+    double max_y = -std::numeric_limits<double>::infinity();
+
+    void merge(double x, double y) {
+        min_x = std::min(min_x, x);
+        min_y = std::min(min_y, y);
+        max_x = std::max(max_x, x);
+        max_y = std::max(max_y, y);
+    }
+    void merge(const Bounds& other) {
+        min_x = std::min(min_x, other.min_x);
+        min_y = std::min(min_y, other.min_y);
+        max_x = std::max(max_x, other.max_x);
+        max_y = std::max(max_y, other.max_y);
+    }
+};
+
+// what drawing a shape produces
+struct Rendered {
+    Bounds bounds{};
+    double area = 0;
+    std::size_t vertices = 0;
+    std::uint64_t checksum = 0; // of the vertices, in drawing order
+};
+
+// one frame: what was recomputed, and where to log it
+struct Frame {
+    bool full = false; // ignore the caches, as composite.cpp does
+    std::size_t leaves = 0, composites = 0;
+    std::ostream* log = nullptr;
+};
+
+// basic elements interface
+// parents are not owned: a composite unregisters itself from its children
+// when it is destroyed
+class IShape {
+    friend class Composite;
+
+    std::vector<IShape*> parents_{};
+    Rendered cache_{};
+    bool dirty_ = true;
+
+    void add_parent(IShape& parent) { parents_.push_back(&parent); }
+    void remove_parent(IShape& parent) {
+        auto it = std::find(parents_.begin(), parents_.end(), &parent);
+        if (it != parents_.end())
+            parents_.erase(it);
+    }
+
+  protected:
+    // to be called by every change of what draw() would produce
+    void mark_dirty() {
+        if (dirty_)
+            return; // the ancestors of a dirty shape are dirty already
+        dirty_ = true;
+        for (IShape* parent : parents_)
+            parent->mark_dirty();
+    }
+    virtual Rendered redraw(Frame& frame) = 0;
+
+  public:
+    IShape() = default;
+    // a copy would share the parents, which only know the original
+    IShape(const IShape&) = delete;
+    IShape& operator=(const IShape&) = delete;
+
+    virtual void add(std::shared_ptr<IShape> elem) = 0;
+    // cached unless something changed (or the frame is a full one)
+    const Rendered& draw(Frame& frame) {
+        if (dirty_ || frame.full) {
+            cache_ = redraw(frame);
+            dirty_ = false;
+        }
+        return cache_;
+    }
+    bool dirty() const { return dirty_; }
+    virtual ~IShape() = default;
+};
+
+inline std::uint64_t mix(std::uint64_t hash, double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (hash ^ bits) * 0x100000001b3ULL;
+}
+
+// concrete basic element (leaf)
+class Circle : public IShape {
+    double x_, y_, radius_;
+    static constexpr std::size_t segments = 32;
+
+    Rendered redraw(Frame& frame) override {
+        ++frame.leaves;
+        if (frame.log)
+            *frame.log << "Drawing a Circle\n";
+        // tessellate
+        Rendered result;
+        const double pi = std::acos(-1.0);
+        for (std::size_t i = 0; i < segments; ++i) {
+            double angle = 2 * pi * static_cast<double>(i) / segments;
+            double x = x_ + radius_ * std::cos(angle);
+            double y = y_ + radius_ * std::sin(angle);
+            result.bounds.merge(x, y);
+            result.checksum = mix(mix(result.checksum, x), y);
+        }
+        result.vertices = segments;
+        result.area = pi * radius_ * radius_;
+        return result;
+    }
+
+  public:
+    Circle(double x = 0, double y = 0, double radius = 1)
+        : x_{x}, y_{y}, radius_{radius} {}
+    // this is a leaf, nothing to add
+    void add(std::shared_ptr<IShape>) override {}
+    void move_to(double x, double y) {
+        x_ = x;
+        y_ = y;
+        mark_dirty();
+    }
+    void set_radius(double radius) {
+        radius_ = radius;
+        mark_dirty();
+    }
+};
+
+constexpr std::size_t Circle::segments;
+
+// concrete basic element (leaf)
+class Square : public IShape {
+    double x_, y_, side_;
+
+    Rendered redraw(Frame& frame) override {
+        ++frame.leaves;
+        if (frame.log)
+            *frame.log << "Drawing a Square\n";
+        Rendered result;
+        const double corners[4][2] = {{x_, y_},
+                                      {x_ + side_, y_},
+                                      {x_ + side_, y_ + side_},
+                                      {x_, y_ + side_}};
+        for (auto&& corner : corners) {
+            result.bounds.merge(corner[0], corner[1]);
+            result.checksum = mix(mix(result.checksum, corner[0]), corner[1]);
+        }
+        result.vertices = 4;
+        result.area = side_ * side_;
+        return result;
+    }
+
+  public:
+    Square(double x = 0, double y = 0, double side = 1)
+        : x_{x}, y_{y}, side_{side} {}
+    // this is a leaf, nothing to add
+    void add(std::shared_ptr<IShape>) override {}
+    void move_to(double x, double y) {
+        x_ = x;
+        y_ = y;
+        mark_dirty();
+    }
+    void set_side(double side) {
+        side_ = side;
+        mark_dirty();
+    }
+};
+
+// composite, combines the (cached) results of its elements
+class Composite : public IShape {
+    std::vector<std::shared_ptr<IShape>> collection_;
+
+    Rendered redraw(Frame& frame) override {
+        ++frame.composites;
+        if (frame.log)
+            *frame.log << "Composite\n";
+        // delegate to the individual elements
+        Rendered result;
+        for (auto&& elem : collection_) {
+            const Rendered& part = elem->draw(frame);
+            result.bounds.merge(part.bounds);
+            result.area += part.area;
+            result.vertices += part.vertices;
+            result.checksum = (result.checksum ^ part.checksum) * 31 + 1;
+        }
+        return result;
+    }
+
+  public:
+    void add(std::shared_ptr<IShape> elem) override {
+        elem->add_parent(*this);
+        collection_.push_back(elem);
+        mark_dirty();
+    }
+    void remove(const std::shared_ptr<IShape>& elem) {
+        auto it = std::find(collection_.begin(), collection_.end(), elem);
+        if (it == collection_.end())
+            return;
+        elem->remove_parent(*this);
+        collection_.erase(it);
+        mark_dirty();
+    }
+    ~Composite() override {
+        for (auto&& elem : collection_)
+            elem->remove_parent(*this);
+    }
+};
+
+int main(int argc, char** argv) {
+    auto circle = std::make_shared<Circle>();
+    auto square = std::make_shared<Square>();
+
+    // create a first-level composition
+    auto shapes = std::make_shared<Composite>();
+    shapes->add(circle);
+    shapes->add(square);
+
+    // create a composition of 2 first level compositions (shared subtree)
+    auto collection_of_shapes = std::make_shared<Composite>();
+    collection_of_shapes->add(shapes);
+    collection_of_shapes->add(shapes);
+
+    Frame frame;
+    frame.log = &std::cout;
+    std::cout << "First frame:\n";
+    collection_of_shapes->draw(frame);
+    std::cout << "\nUnchanged frame:\n";
+    collection_of_shapes->draw(frame);
+    std::cout << "\nAfter resizing the circle:\n";
+    circle->set_radius(2);
+    const Rendered& rendered = collection_of_shapes->draw(frame);
+    std::cout << "Area " << rendered.area << ", " << rendered.vertices
+              << " vertices\n\n";
+
+    // a large scene: groups of 8 shapes, 8 groups per level
+    std::mt19937 gen{42};
+    std::uniform_real_distribution<double> coordinate(0, 1000);
+    const std::size_t n_leaves = 1 << 15;
+    std::vector<std::shared_ptr<Circle>> circles;
+    std::vector<std::shared_ptr<IShape>> level;
+    for (std::size_t i = 0; i < n_leaves; ++i) {
+        if (i % 2) {
+            circles.push_back(std::make_shared<Circle>(
+                coordinate(gen), coordinate(gen), 1 + coordinate(gen) / 100));
+            level.push_back(circles.back());
+        } else {
+            level.push_back(std::make_shared<Square>(
+                coordinate(gen), coordinate(gen), 1 + coordinate(gen) / 100));
+        }
+    }
+    while (level.size() > 1) {
+        std::vector<std::shared_ptr<IShape>> parents;
+        for (std::size_t i = 0; i < level.size(); i += 8) {
+            auto group = std::make_shared<Composite>();
+            for (std::size_t j = i; j < std::min(level.size(), i + 8); ++j)
+                group->add(level[j]);
+            parents.push_back(group);
+        }
+        level = std::move(parents);
+    }
+    std::shared_ptr<IShape> scene = level.front();
+    Frame first;
+    scene->draw(first);
+
+    // per frame, move `changes` random circles and redraw
+    std::uniform_int_distribution<std::size_t> pick(0, circles.size() - 1);
+    for (std::size_t changes : {1, 100}) {
+        Frame counted;
+        for (std::size_t i = 0; i < changes; ++i)
+            circles[pick(gen)]->move_to(coordinate(gen), coordinate(gen));
+        scene->draw(counted);
+        std::cout << changes << " change(s): redrew " << counted.leaves
+                  << " leaves and " << counted.composites
+                  << " composites of " << first.leaves << " and "
+                  << first.composites << '\n';
+    }
+    std::cout << '\n';
+
+    // ops are frames
+    bench::Suite suite{"composite_incremental", argc, argv};
+    suite.add("full_redraw", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            Frame full;
+            full.full = true;
+            bench::do_not_optimize(scene->draw(full).checksum);
+        }
+    });
+    for (std::size_t changes : {0, 1, 100}) {
+        suite.add("incremental/changes=" + std::to_string(changes),
+                  [&, changes](std::size_t n) {
+                      for (std::size_t i = 0; i < n; ++i) {
+                          for (std::size_t c = 0; c < changes; ++c)
+                              circles[pick(gen)]->set_radius(
+                                  1 + coordinate(gen) / 100);
+                          Frame incremental;
+                          bench::do_not_optimize(
+                              scene->draw(incremental).checksum);
+                      }
+                  });
+    }
+    return suite.run();
+}
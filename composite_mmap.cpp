@@ -0,0 +1,444 @@
+// Composite design pattern, memory-mapped binary trees
+// a shape tree is written once in a compact binary format: records hold
+// relative offsets instead of pointers, shared subtrees are stored once;
+// loading the tree is a single mmap, it is traversed in place without any
+// deserialization
+
+// compile with g++ -std=c++14 -O2 composite_mmap.cpp -ocomposite_mmap
+// POSIX only (mmap)
+// command line: --shapes N, the size of the large scene (at least 8,
+// default 10M)
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// on-disk layout: a header followed by 8-byte aligned records, children
+// before their parents; a composite refers to its children by their offset
+// relative to its own record, so the file can be mapped anywhere
+namespace shape_file {
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t root; // offset of the root record
+    std::uint64_t records;
+    std::uint64_t size; // of the whole file
+};
+
+enum Kind : std::uint32_t { CIRCLE = 1, SQUARE = 2, COMPOSITE = 3 };
+
+struct Record {
+    std::uint32_t kind;
+    std::uint32_t count; // composites: number of children
+};
+
+// circles and squares
+struct Leaf_Record {
+    Record record;
+    double x, y, size; // radius or side
+};
+
+// followed by count relative offsets (std::int64_t)
+struct Composite_Record {
+    Record record;
+};
+
+constexpr char magic[8] = {'S', 'H', 'A', 'P', 'E', 'S', '\0', '\0'};
+constexpr std::uint32_t version = 1;
+} // namespace shape_file
+
+const double pi = std::acos(-1.0);
+
+class Tree_Writer;
+
+// basic elements interface
+struct IShape {
+    virtual void add(std::shared_ptr<IShape> elem) = 0;
+    virtual void draw() const = 0;
+    virtual double area() const = 0;
+    // writes the record(s) of the shape, returns the offset of its record
+    virtual std::uint64_t write(Tree_Writer& writer) const = 0;
+    virtual ~IShape() = default;
+};
+
+// writes a live tree in the shape_file format
+class Tree_Writer {
+    std::string path_;
+    std::ofstream out_;
+    std::uint64_t offset_ = sizeof(shape_file::Header);
+    std::uint64_t records_ = 0;
+    // offsets of the shapes referenced more than once
+    std::unordered_map<const IShape*, std::uint64_t> shared_{};
+
+    std::uint64_t append(const void* data, std::size_t size) {
+        std::uint64_t offset = offset_;
+        out_.write(static_cast<const char*>(data),
+                   static_cast<std::streamsize>(size));
+        offset_ += size;
+        return offset;
+    }
+
+  public:
+    explicit Tree_Writer(const std::string& path)
+        : path_{path}, out_{path, std::ios::binary | std::ios::trunc} {
+        if (!out_)
+            throw std::runtime_error("Cannot open " + path + " for writing!");
+        shape_file::Header header{};
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    std::uint64_t leaf(shape_file::Kind kind, double x, double y,
+                       double size) {
+        ++records_;
+        shape_file::Leaf_Record record{{kind, 0}, x, y, size};
+        return append(&record, sizeof(record));
+    }
+    std::uint64_t composite(const std::vector<std::uint64_t>& children) {
+        if (children.size() > 0xffffffff)
+            throw std::length_error("Tree_Writer: too many children");
+        ++records_;
+        shape_file::Composite_Record record{
+            {shape_file::COMPOSITE,
+             static_cast<std::uint32_t>(children.size())}};
+        std::uint64_t offset = append(&record, sizeof(record));
+        for (std::uint64_t child : children) {
+            auto relative = static_cast<std::int64_t>(child - offset);
+            append(&relative, sizeof(relative));
+        }
+        return offset;
+    }
+
+    // a shape owned by several composites is written once; only shapes
+    // whose use count says they may be shared are looked up
+    std::uint64_t write(const std::shared_ptr<IShape>& shape) {
+        if (shape.use_count() == 1)
+            return shape->write(*this);
+        auto it = shared_.find(shape.get());
+        if (it != shared_.end())
+            return it->second;
+        std::uint64_t offset = shape->write(*this);
+        shared_.emplace(shape.get(), offset);
+        return offset;
+    }
+
+    // writes the tree rooted at root, and the header
+    void finish(const std::shared_ptr<IShape>& root) {
+        shape_file::Header header{};
+        header.root = write(root);
+        std::memcpy(header.magic, shape_file::magic, sizeof(header.magic));
+        header.version = shape_file::version;
+        header.records = records_;
+        header.size = offset_;
+        out_.seekp(0);
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out_.flush();
+        if (!out_)
+            throw std::runtime_error("Error while writing " + path_ + "!");
+    }
+};
+
+// concrete basic element (leaf)
+class Circle : public IShape {
+    double x_, y_, radius_;
+
+  public:
+    Circle(double x = 0, double y = 0, double radius = 1)
+        : x_{x}, y_{y}, radius_{radius} {}
+    // this is a leaf, nothing to add
+    void add(std::shared_ptr<IShape>) override {}
+    void draw() const override { std::cout << "Drawing a Circle\n"; }
+    double area() const override { return pi * radius_ * radius_; }
+    std::uint64_t write(Tree_Writer& writer) const override {
+        return writer.leaf(shape_file::CIRCLE, x_, y_, radius_);
+    }
+};
+
+// concrete basic element (leaf)
+class Square : public IShape {
+    double x_, y_, side_;
+
+  public:
+    Square(double x = 0, double y = 0, double side = 1)
+        : x_{x}, y_{y}, side_{side} {}
+    // this is a leaf, nothing to add
+    void add(std::shared_ptr<IShape>) override {}
+    void draw() const override { std::cout << "Drawing a Square\n"; }
+    double area() const override { return side_ * side_; }
+    std::uint64_t write(Tree_Writer& writer) const override {
+        return writer.leaf(shape_file::SQUARE, x_, y_, side_);
+    }
+};
+
+// composite
+class Composite : public IShape {
+    std::vector<std::shared_ptr<IShape>> collection_;
+
+  public:
+    void add(std::shared_ptr<IShape> elem) override {
+        collection_.push_back(elem);
+    }
+    void draw() const override {
+        std::cout << "Composite\n";
+        // delegate to the individual elements
+        for (auto&& elem : collection_) {
+            elem->draw();
+        }
+    }
+    double area() const override {
+        double total = 0;
+        for (auto&& elem : collection_)
+            total += elem->area();
+        return total;
+    }
+    std::uint64_t write(Tree_Writer& writer) const override {
+        std::vector<std::uint64_t> children;
+        children.reserve(collection_.size());
+        for (auto&& elem : collection_)
+            children.push_back(writer.write(elem));
+        return writer.composite(children);
+    }
+};
+
+// a shape in a mapped file, a position and nothing else
+class Shape_View {
+    const char* base_;
+    std::uint64_t offset_;
+
+    template <typename T>
+    const T& as() const {
+        return *reinterpret_cast<const T*>(base_ + offset_);
+    }
+
+  public:
+    Shape_View(const char* base, std::uint64_t offset)
+        : base_{base}, offset_{offset} {}
+
+    shape_file::Kind kind() const {
+        return static_cast<shape_file::Kind>(as<shape_file::Record>().kind);
+    }
+    // composites
+    std::size_t size() const { return as<shape_file::Record>().count; }
+    Shape_View operator[](std::size_t i) const {
+        const char* offsets = base_ + offset_ + sizeof(shape_file::Record);
+        std::int64_t relative;
+        std::memcpy(&relative, offsets + i * sizeof(relative),
+                    sizeof(relative));
+        return {base_, offset_ + static_cast<std::uint64_t>(relative)};
+    }
+    // leaves
+    double x() const { return as<shape_file::Leaf_Record>().x; }
+    double y() const { return as<shape_file::Leaf_Record>().y; }
+    double extent() const { return as<shape_file::Leaf_Record>().size; }
+
+    void draw() const {
+        switch (kind()) {
+            case shape_file::CIRCLE:
+                std::cout << "Drawing a Circle\n";
+                break;
+            case shape_file::SQUARE:
+                std::cout << "Drawing a Square\n";
+                break;
+            case shape_file::COMPOSITE:
+                std::cout << "Composite\n";
+                for (std::size_t i = 0; i < size(); ++i)
+                    (*this)[i].draw();
+                break;
+        }
+    }
+    double area() const {
+        switch (kind()) {
+            case shape_file::CIRCLE:
+                return pi * extent() * extent();
+            case shape_file::SQUARE:
+                return extent() * extent();
+            case shape_file::COMPOSITE:
+                break;
+        }
+        double total = 0;
+        for (std::size_t i = 0; i < size(); ++i)
+            total += (*this)[i].area();
+        return total;
+    }
+};
+
+// read-only shape tree backed by a memory-mapped file
+// loading checks the header only, the records are trusted
+class Mapped_Tree {
+    void* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    shape_file::Header header_{};
+
+  public:
+    explicit Mapped_Tree(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path + "!");
+        struct stat st {};
+        if (::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) <
+                                        sizeof(shape_file::Header)) {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a shape file!");
+        }
+        map_size_ = st.st_size;
+        map_ = ::mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (map_ == MAP_FAILED)
+            throw std::runtime_error("Cannot map " + path + "!");
+
+        std::memcpy(&header_, map_, sizeof(header_));
+        if (std::memcmp(header_.magic, shape_file::magic,
+                        sizeof(header_.magic)) != 0 ||
+            header_.version != shape_file::version ||
+            header_.size != map_size_ || header_.root % 8 != 0 ||
+            header_.root < sizeof(header_) ||
+            header_.root + sizeof(shape_file::Record) > map_size_) {
+            ::munmap(map_, map_size_);
+            throw std::runtime_error(path + " has an incompatible layout!");
+        }
+    }
+    Mapped_Tree(const Mapped_Tree&) = delete;
+    Mapped_Tree& operator=(const Mapped_Tree&) = delete;
+    ~Mapped_Tree() { ::munmap(map_, map_size_); }
+
+    Shape_View root() const {
+        return {static_cast<const char*>(map_), header_.root};
+    }
+    std::size_t records() const { return header_.records; }
+    std::size_t bytes() const { return map_size_; }
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+int main(int argc, char** argv) {
+    std::size_t n_shapes = 10000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        char* end = nullptr;
+        if (arg == "--shapes" && i + 1 < argc && argv[i + 1][0] != '-') {
+            n_shapes = std::strtoull(argv[++i], &end, 10);
+            if (*end == '\0' && n_shapes >= 8)
+                continue;
+        }
+        std::cerr << "usage: " << argv[0] << " [--shapes N], N >= 8\n";
+        return EXIT_FAILURE;
+    }
+    const std::string path = "shapes.bin";
+
+    // the composition of composite.cpp, with a shared subtree
+    {
+        auto circle = std::make_shared<Circle>();
+        auto square = std::make_shared<Square>();
+        auto shapes = std::make_shared<Composite>();
+        shapes->add(circle);
+        shapes->add(square);
+        auto collection_of_shapes = std::make_shared<Composite>();
+        collection_of_shapes->add(shapes);
+        collection_of_shapes->add(shapes);
+
+        Tree_Writer writer{path};
+        writer.finish(collection_of_shapes);
+        Mapped_Tree mapped{path};
+        std::cout << mapped.records() << " records, " << mapped.bytes()
+                  << " bytes\n";
+        mapped.root().draw();
+        std::cout << '\n';
+    }
+
+    // large scene: groups of 8 shapes, 8 groups per level, and a logo shared
+    // by every 64th group
+    double write_ms, live_area;
+    std::size_t live_shapes = 0;
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::mt19937 gen{42};
+        std::uniform_real_distribution<double> coordinate(0, 1000);
+        auto logo = std::make_shared<Composite>();
+        logo->add(std::make_shared<Circle>(0, 0, 5));
+        logo->add(std::make_shared<Square>(-5, -5, 10));
+        std::vector<std::shared_ptr<IShape>> level;
+        const std::size_t n_leaves = n_shapes / 8 * 7;
+        level.reserve(n_leaves);
+        for (std::size_t i = 0; i < n_leaves; ++i) {
+            if (i % 2)
+                level.push_back(std::make_shared<Circle>(
+                    coordinate(gen), coordinate(gen), coordinate(gen) / 100));
+            else
+                level.push_back(std::make_shared<Square>(
+                    coordinate(gen), coordinate(gen), coordinate(gen) / 100));
+        }
+        live_shapes = n_leaves + 3; // and the logo
+        while (level.size() > 1) {
+            std::vector<std::shared_ptr<IShape>> parents;
+            parents.reserve(level.size() / 8 + 1);
+            for (std::size_t i = 0; i < level.size(); i += 8) {
+                auto group = std::make_shared<Composite>();
+                for (std::size_t j = i; j < std::min(level.size(), i + 8); ++j)
+                    group->add(level[j]);
+                if (parents.size() % 64 == 0)
+                    group->add(logo);
+                parents.push_back(group);
+            }
+            live_shapes += parents.size();
+            level = std::move(parents);
+        }
+        std::shared_ptr<IShape> scene = level.front();
+        double build_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        live_area = scene->area();
+        double live_traverse_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        Tree_Writer writer{path};
+        writer.finish(scene);
+        write_ms = elapsed_ms(start);
+
+        std::cout << std::fixed << std::setprecision(1) << live_shapes
+                  << " shapes\n"
+                  << "build with add():   " << std::setw(10) << build_ms
+                  << " ms\n"
+                  << "live traversal:     " << std::setw(10)
+                  << live_traverse_ms << " ms\n";
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Mapped_Tree mapped{path};
+    double map_ms = elapsed_ms(start);
+    start = std::chrono::steady_clock::now();
+    double mapped_area = mapped.root().area();
+    double mapped_traverse_ms = elapsed_ms(start);
+
+    std::cout << "write:              " << std::setw(10) << write_ms
+              << " ms (" << mapped.records() << " records, "
+              << mapped.bytes() / (1 << 20) << " MiB)\n"
+              << "load with mmap:     " << std::setw(10) << map_ms
+              << " ms\n"
+              << "mapped traversal:   " << std::setw(10) << mapped_traverse_ms
+              << " ms\n"
+              << "same area? " << std::boolalpha
+              << (live_area == mapped_area) << '\n';
+    std::remove(path.c_str());
+}
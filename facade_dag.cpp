@@ -0,0 +1,383 @@
+// Facade design pattern, dependency-graph variant
+// every step of a start/stop sequence declares what it depends on, the facade
+// runs the resulting DAG on a thread pool with as much parallelism as the
+// dependencies allow, then reports per-step timings and the critical path
+
+// compile with g++ -std=c++14 -O2 -pthread facade_dag.cpp -ofacade_dag
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// serializes the output of concurrently running subsystems
+std::mutex cout_mutex;
+void say(const std::string& what) {
+    std::lock_guard<std::mutex> lock{cout_mutex};
+    std::cout << what << '\n';
+}
+
+// complex systems, each operation takes a while
+class Engine {
+  public:
+    void start() const {
+        say("Starting the engine.");
+        std::this_thread::sleep_for(std::chrono::milliseconds{60});
+    }
+    void stop() const {
+        say("Stopping the engine.");
+        std::this_thread::sleep_for(std::chrono::milliseconds{40});
+    }
+};
+
+class Hand_Brake {
+  public:
+    void pull() const {
+        say("Pulling the hand brake.");
+        std::this_thread::sleep_for(std::chrono::milliseconds{30});
+    }
+    void release() const {
+        say("Releasing the hand brake.");
+        std::this_thread::sleep_for(std::chrono::milliseconds{30});
+    }
+};
+
+class Gear_Box {
+  public:
+    void park() const {
+        say("Setting the gearbox to PARK.");
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    }
+    void drive() const {
+        say("Setting the gearbox to DRIVE.");
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    }
+};
+
+// fixed-size pool of worker threads
+class Thread_Pool {
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_{};
+    std::mutex mutex_{};
+    std::condition_variable cv_{};
+    bool stop_ = false;
+
+  public:
+    explicit Thread_Pool(std::size_t n_threads) : workers_{} {
+        for (std::size_t i = 0; i < std::max<std::size_t>(1, n_threads); ++i)
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock{mutex_};
+                        cv_.wait(lock,
+                                 [this] { return stop_ || !tasks_.empty(); });
+                        if (tasks_.empty())
+                            return;
+                        task = std::move(tasks_.front());
+                        tasks_.pop();
+                    }
+                    task();
+                }
+            });
+    }
+    Thread_Pool(const Thread_Pool&) = delete;
+    Thread_Pool& operator=(const Thread_Pool&) = delete;
+    ~Thread_Pool() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto&& worker : workers_)
+            worker.join();
+    }
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            tasks_.push(std::move(task));
+        }
+        cv_.notify_one();
+    }
+    std::size_t size() const { return workers_.size(); }
+};
+
+// what happened during one run of a sequence, times in milliseconds since
+// the start of the run
+struct Run_Report {
+    struct Step_Timing {
+        std::string name;
+        double start, end;
+    };
+    std::vector<Step_Timing> steps;
+    std::vector<std::string> critical_path;
+    double critical_path_ms = 0;
+    double wall_ms = 0;
+
+    friend std::ostream& operator<<(std::ostream& os, const Run_Report& rhs) {
+        os << std::fixed << std::setprecision(1);
+        for (auto&& step : rhs.steps)
+            os << "\t" << std::left << std::setw(16) << step.name << std::right
+               << std::setw(7) << step.start << " -> " << std::setw(7)
+               << step.end << " ms\n";
+        os << "\tcritical path (" << rhs.critical_path_ms << " ms):";
+        for (auto&& name : rhs.critical_path)
+            os << ' ' << name;
+        return os << "\n\twall time " << rhs.wall_ms << " ms\n";
+    }
+};
+
+// a validated DAG of steps, runnable any number of times
+class Sequence {
+    struct Step {
+        std::string name;
+        std::function<void()> action;
+        std::vector<std::size_t> dependencies;
+        std::vector<std::size_t> dependents;
+    };
+    std::vector<Step> steps_;
+    std::vector<std::size_t> topological_order_;
+
+    friend class Sequence_Builder;
+    Sequence(std::vector<Step> steps, std::vector<std::size_t> order)
+        : steps_{std::move(steps)}, topological_order_{std::move(order)} {}
+
+  public:
+    // runs every step once its dependencies are done, rethrows the first
+    // exception after the run; the dependents of a failed step are skipped
+    Run_Report run(Thread_Pool& pool) const {
+        using clock = std::chrono::steady_clock;
+        const std::size_t n = steps_.size();
+        auto origin = clock::now();
+        auto since_origin = [origin] {
+            return std::chrono::duration<double, std::milli>(clock::now() -
+                                                             origin)
+                .count();
+        };
+
+        std::unique_ptr<std::atomic<std::size_t>[]> waiting{
+            new std::atomic<std::size_t>[n]};
+        for (std::size_t i = 0; i < n; ++i)
+            waiting[i] = steps_[i].dependencies.size();
+        std::vector<Run_Report::Step_Timing> timings(n);
+        std::vector<char> failed(n, 0);
+
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        std::size_t done = 0;
+        std::exception_ptr error;
+
+        std::function<void(std::size_t)> launch = [&](std::size_t i) {
+            pool.submit([&, i] {
+                bool skip = false;
+                for (auto dep : steps_[i].dependencies)
+                    skip = skip || failed[dep];
+                timings[i].start = since_origin();
+                if (skip) {
+                    failed[i] = 1;
+                } else {
+                    try {
+                        steps_[i].action();
+                    } catch (...) {
+                        failed[i] = 1;
+                        std::lock_guard<std::mutex> lock{mutex};
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                }
+                timings[i].end = since_origin();
+                for (auto next : steps_[i].dependents)
+                    if (--waiting[next] == 0)
+                        launch(next);
+                std::lock_guard<std::mutex> lock{mutex};
+                if (++done == n)
+                    done_cv.notify_one();
+            });
+        };
+        for (std::size_t i = 0; i < n; ++i)
+            if (steps_[i].dependencies.empty())
+                launch(i);
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            done_cv.wait(lock, [&] { return done == n; });
+        }
+
+        Run_Report report;
+        report.wall_ms = since_origin();
+        for (std::size_t i = 0; i < n; ++i) {
+            timings[i].name = steps_[i].name;
+            report.steps.push_back(timings[i]);
+        }
+        std::sort(report.steps.begin(), report.steps.end(),
+                  [](auto&& lhs, auto&& rhs) { return lhs.start < rhs.start; });
+
+        // critical path: longest chain of measured durations through the DAG
+        std::vector<double> finish(n, 0);
+        std::vector<std::size_t> previous(n, n);
+        for (auto i : topological_order_) {
+            double begin = 0;
+            for (auto dep : steps_[i].dependencies)
+                if (finish[dep] > begin) {
+                    begin = finish[dep];
+                    previous[i] = dep;
+                }
+            finish[i] = begin + (timings[i].end - timings[i].start);
+        }
+        if (n) {
+            auto last = static_cast<std::size_t>(
+                std::max_element(finish.begin(), finish.end()) -
+                finish.begin());
+            report.critical_path_ms = finish[last];
+            for (auto i = last; i != n; i = previous[i])
+                report.critical_path.push_back(steps_[i].name);
+            std::reverse(report.critical_path.begin(),
+                         report.critical_path.end());
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+        return report;
+    }
+};
+
+// collects the steps and their dependencies, checks the graph on build()
+class Sequence_Builder {
+    std::vector<Sequence::Step> steps_{};
+    std::vector<std::vector<std::string>> dependency_names_{};
+
+  public:
+    Sequence_Builder& step(std::string name, std::function<void()> action,
+                           std::vector<std::string> dependencies = {}) {
+        steps_.push_back({std::move(name), std::move(action), {}, {}});
+        dependency_names_.push_back(std::move(dependencies));
+        return *this;
+    }
+
+    Sequence build() const {
+        auto steps = steps_;
+        std::map<std::string, std::size_t> index;
+        for (std::size_t i = 0; i < steps.size(); ++i)
+            if (!index.emplace(steps[i].name, i).second)
+                throw std::invalid_argument("Duplicate step " + steps[i].name);
+        for (std::size_t i = 0; i < steps.size(); ++i)
+            for (auto&& name : dependency_names_[i]) {
+                auto found = index.find(name);
+                if (found == index.end())
+                    throw std::invalid_argument("Unknown dependency " + name +
+                                                " of " + steps[i].name);
+                steps[i].dependencies.push_back(found->second);
+                steps[found->second].dependents.push_back(i);
+            }
+
+        // Kahn's algorithm, anything left over is part of a cycle
+        std::vector<std::size_t> in_degree(steps.size()), order, ready;
+        for (std::size_t i = 0; i < steps.size(); ++i)
+            if ((in_degree[i] = steps[i].dependencies.size()) == 0)
+                ready.push_back(i);
+        while (!ready.empty()) {
+            auto i = ready.back();
+            ready.pop_back();
+            order.push_back(i);
+            for (auto next : steps[i].dependents)
+                if (--in_degree[next] == 0)
+                    ready.push_back(next);
+        }
+        if (order.size() != steps.size())
+            throw std::invalid_argument("The steps have a dependency cycle");
+        return {std::move(steps), std::move(order)};
+    }
+};
+
+// facade interface
+struct IFacade {
+    virtual Run_Report start() const = 0;
+    virtual Run_Report stop() const = 0;
+    virtual ~IFacade() = default;
+};
+
+// concrete facade, only the real orderings are declared
+class Car_Facade : public IFacade {
+    Engine engine_{};
+    Hand_Brake hand_brake_{};
+    Gear_Box gear_box_{};
+    Thread_Pool& pool_;
+    Sequence start_, stop_;
+
+  public:
+    explicit Car_Facade(Thread_Pool& pool)
+        : pool_{pool},
+          start_{Sequence_Builder{}
+                     .step("engine.start", [this] { engine_.start(); })
+                     .step("gear_box.drive", [this] { gear_box_.drive(); },
+                           {"engine.start"})
+                     .step("brake.release", [this] { hand_brake_.release(); },
+                           {"engine.start"})
+                     .build()},
+          stop_{Sequence_Builder{}
+                    .step("gear_box.park", [this] { gear_box_.park(); })
+                    .step("brake.pull", [this] { hand_brake_.pull(); })
+                    .step("engine.stop", [this] { engine_.stop(); },
+                          {"gear_box.park", "brake.pull"})
+                    .build()} {}
+    // the steps are bound to this facade's subsystems, so it stays put
+    Car_Facade(const Car_Facade&) = delete;
+    Car_Facade& operator=(const Car_Facade&) = delete;
+
+    Run_Report start() const override {
+        say("STARTING THE CAR");
+        return start_.run(pool_);
+    }
+    Run_Report stop() const override {
+        say("STOPPING THE CAR");
+        return stop_.run(pool_);
+    }
+};
+
+int main() {
+    Thread_Pool pool{4};
+    Car_Facade car_facade{pool};
+    std::cout << car_facade.start() << '\n';
+    std::cout << car_facade.stop() << '\n';
+
+    // a larger initialization: 24 subsystems in 4 layers, each depends on
+    // two subsystems of the previous layer
+    Sequence_Builder builder;
+    const std::size_t layers = 4, width = 6;
+    for (std::size_t l = 0; l < layers; ++l)
+        for (std::size_t w = 0; w < width; ++w) {
+            std::vector<std::string> dependencies;
+            if (l > 0) {
+                dependencies.push_back("s" + std::to_string(l - 1) + "_" +
+                                       std::to_string(w));
+                dependencies.push_back("s" + std::to_string(l - 1) + "_" +
+                                       std::to_string((w + 1) % width));
+            }
+            auto ms = std::chrono::milliseconds{5 + 5 * ((l + w) % 3)};
+            builder.step("s" + std::to_string(l) + "_" + std::to_string(w),
+                         [ms] { std::this_thread::sleep_for(ms); },
+                         dependencies);
+        }
+    auto subsystems = builder.build();
+
+    Thread_Pool serial{1};
+    auto one = subsystems.run(serial);
+    auto many = subsystems.run(pool);
+    std::cout << std::fixed << std::setprecision(1)
+              << "24 subsystems, 1 thread:  " << one.wall_ms << " ms\n"
+              << "24 subsystems, " << pool.size()
+              << " threads: " << many.wall_ms << " ms (critical path "
+              << many.critical_path_ms << " ms)\n";
+}
@@ -0,0 +1,310 @@
+// Facade design pattern, fleet (struct-of-arrays) variant
+// one facade drives many vehicles at once, the subsystem state lives in
+// dense per-subsystem arrays so bulk start/stop are plain vectorizable loops
+
+// compile with g++ -std=c++14 -O3 -pthread facade_fleet.cpp -ofacade_fleet
+// (GCC vectorizes the bulk loops from -O3 on)
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bench/bench.h"
+
+enum Gear : std::uint8_t { PARK, DRIVE, REVERSE, NEUTRAL };
+
+// per-object subsystems and facades, as in facade.cpp but without the I/O
+class Engine {
+    bool on_ = false;
+
+  public:
+    void start() { on_ = true; }
+    void stop() { on_ = false; }
+    bool is_on() const { return on_; }
+};
+
+class Hand_Brake {
+    bool pulled_ = true;
+
+  public:
+    void pull() { pulled_ = true; }
+    void release() { pulled_ = false; }
+};
+
+class Gear_Box {
+    Gear gear_ = PARK;
+
+  public:
+    void park() { gear_ = PARK; }
+    void drive() { gear_ = DRIVE; }
+};
+
+struct IFacade {
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    virtual bool is_on() const = 0;
+    virtual ~IFacade() = default;
+};
+
+class Car_Facade : public IFacade {
+    Engine engine_{};
+    Hand_Brake hand_brake_{};
+    Gear_Box gear_box_{};
+
+  public:
+    void start() override {
+        engine_.start();
+        hand_brake_.release();
+        gear_box_.drive();
+    }
+    void stop() override {
+        gear_box_.park();
+        hand_brake_.pull();
+        engine_.stop();
+    }
+    bool is_on() const override { return engine_.is_on(); }
+};
+
+class Scooter_Facade : public IFacade {
+    Engine engine_{};
+
+  public:
+    void start() override { engine_.start(); }
+    void stop() override { engine_.stop(); }
+    bool is_on() const override { return engine_.is_on(); }
+};
+
+// the fleet facade, vehicle i is described by the i-th entry of each array
+class Fleet {
+  public:
+    enum class Kind : std::uint8_t { CAR, SCOOTER };
+    enum class Execution { SEQUENTIAL, PARALLEL };
+
+  private:
+    // 1 for vehicles that have a hand brake and a gear box (cars)
+    std::vector<std::uint8_t> has_transmission_{};
+    std::vector<std::uint8_t> engine_on_{};
+    std::vector<std::uint8_t> brake_pulled_{};
+    std::vector<std::uint8_t> gear_{};
+    std::size_t n_threads_;
+
+    // helper threads started once, woken by every parallel bulk call; the
+    // calling thread runs range 0, helper i runs range i
+    std::vector<std::thread> helpers_{};
+    std::mutex mutex_{};
+    std::condition_variable wake_{}, done_{};
+    std::function<void(std::size_t, std::size_t)> job_{};
+    std::size_t job_size_ = 0, job_chunks_ = 0, job_step_ = 0;
+    std::size_t pending_ = 0;    // helpers still running the job
+    std::uint64_t generation_ = 0; // one per job
+    bool stop_ = false;
+
+    void help(std::size_t chunk) {
+        std::uint64_t seen = 0;
+        for (;;) {
+            std::size_t first, last;
+            std::function<void(std::size_t, std::size_t)>* job;
+            {
+                std::unique_lock<std::mutex> lock{mutex_};
+                wake_.wait(lock,
+                           [&] { return stop_ || generation_ != seen; });
+                if (stop_)
+                    return;
+                seen = generation_;
+                if (chunk >= job_chunks_)
+                    continue; // the fleet is too small for this helper
+                first = chunk * job_step_;
+                last = std::min(job_size_, first + job_step_);
+                job = &job_;
+            }
+            (*job)(first, last);
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (--pending_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    // branch-free bodies, the same for every vehicle kind; the arrays never
+    // overlap, __restrict lets the compiler vectorize without alias checks
+    void start_range(std::size_t first, std::size_t last) {
+        std::uint8_t* __restrict engine = engine_on_.data();
+        std::uint8_t* __restrict brake = brake_pulled_.data();
+        std::uint8_t* __restrict gear = gear_.data();
+        const std::uint8_t* __restrict has = has_transmission_.data();
+        for (std::size_t i = first; i < last; ++i) {
+            engine[i] = 1;
+            brake[i] = brake[i] & (has[i] ^ 1);
+            gear[i] = has[i] ? std::uint8_t{DRIVE} : gear[i];
+        }
+    }
+    void stop_range(std::size_t first, std::size_t last) {
+        std::uint8_t* __restrict engine = engine_on_.data();
+        std::uint8_t* __restrict brake = brake_pulled_.data();
+        std::uint8_t* __restrict gear = gear_.data();
+        const std::uint8_t* __restrict has = has_transmission_.data();
+        for (std::size_t i = first; i < last; ++i) {
+            gear[i] = has[i] ? std::uint8_t{PARK} : gear[i];
+            brake[i] = brake[i] | has[i];
+            engine[i] = 0;
+        }
+    }
+
+    // splits [0, size()) over the calling thread and the helpers
+    template <typename F>
+    void for_ranges(Execution execution, F f) {
+        const std::size_t n = size(), chunks = this->chunks(execution);
+        if (chunks < 2) {
+            f(0, n);
+            return;
+        }
+        const std::size_t step = (n + chunks - 1) / chunks;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            job_ = f;
+            job_size_ = n;
+            job_chunks_ = chunks;
+            job_step_ = step;
+            pending_ = chunks - 1;
+            ++generation_;
+        }
+        wake_.notify_all();
+        f(0, std::min(n, step));
+        std::unique_lock<std::mutex> lock{mutex_};
+        done_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+  public:
+    explicit Fleet(std::size_t n_threads = std::max(
+                       1u, std::thread::hardware_concurrency()))
+        : n_threads_{std::max<std::size_t>(1, n_threads)} {
+        for (std::size_t chunk = 1; chunk < n_threads_; ++chunk)
+            helpers_.emplace_back([this, chunk] { help(chunk); });
+    }
+    Fleet(const Fleet&) = delete;
+    Fleet& operator=(const Fleet&) = delete;
+    ~Fleet() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto&& helper : helpers_)
+            helper.join();
+    }
+
+    // number of ranges a whole-fleet operation is split into; small fleets
+    // stay on the calling thread since waking the helpers costs more than
+    // the loop
+    std::size_t chunks(Execution execution) const {
+        const std::size_t min_chunk = 4096;
+        if (execution == Execution::SEQUENTIAL)
+            return 1;
+        return std::max<std::size_t>(
+            1, std::min(n_threads_, size() / min_chunk));
+    }
+
+    // adds a parked vehicle, returns its id
+    std::size_t add(Kind kind) {
+        has_transmission_.push_back(kind == Kind::CAR);
+        engine_on_.push_back(0);
+        brake_pulled_.push_back(kind == Kind::CAR);
+        gear_.push_back(PARK);
+        return engine_on_.size() - 1;
+    }
+    std::size_t size() const { return engine_on_.size(); }
+    bool is_on(std::size_t id) const { return engine_on_[id]; }
+    std::size_t count_on() const {
+        std::size_t count = 0;
+        for (auto on : engine_on_)
+            count += on;
+        return count;
+    }
+
+    void start_all(Execution execution = Execution::SEQUENTIAL) {
+        for_ranges(execution, [this](std::size_t first, std::size_t last) {
+            start_range(first, last);
+        });
+    }
+    void stop_all(Execution execution = Execution::SEQUENTIAL) {
+        for_ranges(execution, [this](std::size_t first, std::size_t last) {
+            stop_range(first, last);
+        });
+    }
+    // starts/stops a subset of vehicles, the ids need not be sorted
+    void start(const std::vector<std::size_t>& ids) {
+        for (auto id : ids)
+            start_range(id, id + 1);
+    }
+    void stop(const std::vector<std::size_t>& ids) {
+        for (auto id : ids)
+            stop_range(id, id + 1);
+    }
+};
+
+int main(int argc, char** argv) {
+    // every third vehicle is a scooter
+    const std::size_t N = 100000;
+    // at least two workers, so that the parallel path runs on any machine
+    Fleet fleet{std::max(2u, std::thread::hardware_concurrency())};
+    std::vector<std::unique_ptr<IFacade>> facades;
+    for (std::size_t i = 0; i < N; ++i) {
+        bool scooter = i % 3 == 2;
+        fleet.add(scooter ? Fleet::Kind::SCOOTER : Fleet::Kind::CAR);
+        if (scooter)
+            facades.push_back(std::make_unique<Scooter_Facade>());
+        else
+            facades.push_back(std::make_unique<Car_Facade>());
+    }
+
+    fleet.start({0, 2, 5});
+    std::cout << "Started " << fleet.count_on() << " vehicles\n";
+    fleet.start_all();
+    std::cout << "Started " << fleet.count_on() << " vehicles\n";
+    fleet.stop_all(Fleet::Execution::PARALLEL);
+    std::cout << "Started " << fleet.count_on() << " vehicles (stopped in "
+              << fleet.chunks(Fleet::Execution::PARALLEL)
+              << " parallel ranges)\n\n";
+
+    // ops are vehicles started and stopped
+    bench::Suite suite{"facade_fleet", argc, argv};
+    suite.add("per_object_facades", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N) {
+            for (auto&& facade : facades)
+                facade->start();
+            for (auto&& facade : facades)
+                facade->stop();
+        }
+        bench::do_not_optimize(facades.front()->is_on());
+    });
+    suite.add("fleet/sequential", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N) {
+            fleet.start_all();
+            fleet.stop_all();
+        }
+        bench::do_not_optimize(fleet.is_on(0));
+    });
+    suite.add("fleet/parallel", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += N) {
+            fleet.start_all(Fleet::Execution::PARALLEL);
+            fleet.stop_all(Fleet::Execution::PARALLEL);
+        }
+        bench::do_not_optimize(fleet.is_on(0));
+    });
+    std::vector<std::size_t> ids;
+    for (std::size_t i = 0; i < N; i += 7)
+        ids.push_back(i);
+    suite.add("fleet/by_ids", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i += ids.size()) {
+            fleet.start(ids);
+            fleet.stop(ids);
+        }
+        bench::do_not_optimize(fleet.is_on(0));
+    });
+    return suite.run();
+}
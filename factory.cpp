@@ -3,6 +3,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include "instrumentation/factory_instrumentation.h"
 
 // interface for common products that will be created by the factory
 struct IFruit {
@@ -34,20 +35,21 @@ class FruitFactory {
   public:
     FruitFactory() = delete;
 
-    std::unique_ptr<IFruit> static make_fruit(const std::string& fruit) {
+    instrumentation::Unique_Ptr<IFruit> static make_fruit(
+        const std::string& fruit) {
         if (fruit == "apple")
-            return std::make_unique<Apple>();
+            return instrumentation::make_unique<Apple>();
         else if (fruit == "big apple")
-            return std::make_unique<BigApple>();
+            return instrumentation::make_unique<BigApple>();
         else if (fruit == "orange")
-            return std::make_unique<Orange>();
+            return instrumentation::make_unique<Orange>();
 
         return nullptr;
     }
 };
 
 int main() {
-    std::unique_ptr<IFruit> fruit;
+    instrumentation::Unique_Ptr<IFruit> fruit;
 
     fruit = FruitFactory::make_fruit("apple");
     if (fruit)
@@ -72,4 +74,8 @@ int main() {
         std::cout << "Making an " << fruit->get_name() << '\n';
     else
         std::cout << "Sorry, this fruit is too exotic to make!\n";
+
+    // creation statistics, with -DFACTORY_INSTRUMENTATION=1
+    if (instrumentation::enabled)
+        std::cout << instrumentation::to_json(instrumentation::snapshot());
 }
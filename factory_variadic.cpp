@@ -3,12 +3,13 @@
 
 #include <iostream>
 #include <memory>
+#include "instrumentation/factory_instrumentation.h"
 
 class Factory {
   public:
     template <typename T, typename... Params>
     static auto create(Params... params) {
-        return std::make_unique<T>(params...);
+        return instrumentation::make_unique<T>(params...);
     }
 };
 
@@ -23,4 +24,8 @@ struct Bar {
 int main() {
     std::shared_ptr<Foo> foo = Factory::create<Foo>(42);
     auto bar = Factory::create<Bar>(true, 42.5);
+
+    // creation statistics, with -DFACTORY_INSTRUMENTATION=1
+    if (instrumentation::enabled)
+        std::cout << instrumentation::to_json(instrumentation::snapshot());
 }
@@ -0,0 +1,343 @@
+// Creation instrumentation for the factories
+// products made with instrumentation::make_unique<T>() are counted per
+// concrete type: creations, destructions, live objects, bytes and creation
+// latency; every thread records into its own counters without locking, a
+// snapshot sums them up and dumps JSON
+// bytes are sizeof(T) of the type passed to make_unique(), the memory the
+// product allocates itself is not counted
+// opt-in: compile with -DFACTORY_INSTRUMENTATION=1; products are then
+// returned as Unique_Ptr<T>, a std::unique_ptr whose deleter remembers the
+// type that was created (products keep their own dynamic type and convert
+// to Unique_Ptr<Base>); otherwise Unique_Ptr<T> is std::unique_ptr<T>,
+// make_unique() is std::make_unique() and snapshots are empty
+
+#ifndef FACTORY_INSTRUMENTATION_H_
+#define FACTORY_INSTRUMENTATION_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+#ifndef FACTORY_INSTRUMENTATION
+#define FACTORY_INSTRUMENTATION 0
+#endif
+
+namespace instrumentation {
+
+constexpr bool enabled = FACTORY_INSTRUMENTATION != 0;
+
+// totals of one product type over all threads
+struct Product_Stats {
+    std::string name;
+    std::uint64_t created = 0, destroyed = 0;
+    std::int64_t live = 0; // created - destroyed
+    std::uint64_t bytes = 0, live_bytes = 0;
+    double mean_latency_ns = 0;
+    std::uint64_t p50_latency_ns = 0, p99_latency_ns = 0;
+};
+
+// the counters of one thread for one product; written by the owning thread
+// only (relaxed load + store), read by snapshots at any time
+struct Product_Counters {
+    static constexpr std::size_t buckets = 40; // powers of two of ns
+
+    std::atomic<std::uint64_t> created{0}, destroyed{0};
+    std::atomic<std::uint64_t> bytes{0}, freed_bytes{0};
+    std::atomic<std::uint64_t> latency_ns{0};
+    std::atomic<std::uint64_t> latency[buckets] = {};
+
+    static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by,
+                      std::memory_order_relaxed);
+    }
+    static std::size_t bucket(std::uint64_t ns) {
+        std::size_t b = 0;
+        while (ns > 1 && b + 1 < buckets) {
+            ns >>= 1;
+            ++b;
+        }
+        return b;
+    }
+};
+
+class Registry {
+  public:
+    static constexpr std::size_t max_products = 64;
+
+  private:
+    struct Thread_Block {
+        Product_Counters products[max_products];
+    };
+
+    // taken to register, to snapshot and when a thread starts or ends
+    // recording, never while a thread records into its own block
+    mutable std::mutex mutex_{};
+    std::vector<std::string> names_{};
+    // blocks keep their counts when their thread ends and go to the next
+    // thread that records, so there are as many as threads ever ran at once
+    std::vector<std::unique_ptr<Thread_Block>> blocks_{};
+    std::vector<Thread_Block*> free_{};
+
+    // returns the block of the thread to the free list when it ends
+    class Lease {
+        Registry& registry_;
+        Thread_Block*& block_;
+        bool& ended_;
+
+      public:
+        Lease(Registry& registry, Thread_Block*& block, bool& ended)
+            : registry_{registry}, block_{block}, ended_{ended} {}
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() {
+            std::lock_guard<std::mutex> lock{registry_.mutex_};
+            registry_.free_.push_back(block_);
+            block_ = nullptr;
+            ended_ = true;
+        }
+    };
+
+    // with the mutex held
+    Thread_Block* acquire() {
+        if (free_.empty()) {
+            blocks_.emplace_back(new Thread_Block);
+            return blocks_.back().get();
+        }
+        Thread_Block* block = free_.back();
+        free_.pop_back();
+        return block;
+    }
+
+    Registry() = default;
+
+  public:
+    // never destroyed: products may outlive every other static
+    static Registry& instance() {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    std::size_t register_product(std::string name) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (names_.size() == max_products)
+            throw std::length_error("instrumentation: too many products");
+        names_.push_back(std::move(name));
+        return names_.size() - 1;
+    }
+
+    // the block of this thread, nullptr once its lease has ended
+    Thread_Block* local() {
+        thread_local Thread_Block* block = nullptr;
+        thread_local bool ended = false;
+        if (block || ended)
+            return block;
+        std::lock_guard<std::mutex> lock{mutex_};
+        block = acquire();
+        thread_local Lease lease{*this, block, ended};
+        return block;
+    }
+
+    // update(Product_Counters&) on the counters of this thread
+    template <typename F>
+    void record(std::size_t product, F update) {
+        if (Thread_Block* block = local()) {
+            update(block->products[product]);
+            return;
+        }
+        // destructors running after the lease: borrow a free block
+        std::lock_guard<std::mutex> lock{mutex_};
+        Thread_Block* borrowed = acquire();
+        update(borrowed->products[product]);
+        free_.push_back(borrowed);
+    }
+
+    std::vector<Product_Stats> snapshot() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        std::vector<Product_Stats> result(names_.size());
+        for (std::size_t p = 0; p < names_.size(); ++p) {
+            Product_Stats& stats = result[p];
+            stats.name = names_[p];
+            std::uint64_t latency_ns = 0, freed = 0;
+            std::uint64_t histogram[Product_Counters::buckets] = {};
+            for (auto&& block : blocks_) {
+                const Product_Counters& counters = block->products[p];
+                auto load = [](const std::atomic<std::uint64_t>& value) {
+                    return value.load(std::memory_order_relaxed);
+                };
+                stats.created += load(counters.created);
+                stats.destroyed += load(counters.destroyed);
+                stats.bytes += load(counters.bytes);
+                freed += load(counters.freed_bytes);
+                latency_ns += load(counters.latency_ns);
+                for (std::size_t b = 0; b < Product_Counters::buckets; ++b)
+                    histogram[b] += load(counters.latency[b]);
+            }
+            stats.live = static_cast<std::int64_t>(stats.created) -
+                         static_cast<std::int64_t>(stats.destroyed);
+            stats.live_bytes = stats.bytes > freed ? stats.bytes - freed : 0;
+            if (stats.created == 0)
+                continue;
+            stats.mean_latency_ns = static_cast<double>(latency_ns) /
+                                    static_cast<double>(stats.created);
+            // upper bounds of the buckets holding the percentiles
+            auto percentile = [&](double q) {
+                auto rank = static_cast<std::uint64_t>(
+                    q * static_cast<double>(stats.created));
+                std::uint64_t seen = 0;
+                for (std::size_t b = 0; b < Product_Counters::buckets; ++b) {
+                    seen += histogram[b];
+                    if (seen > rank)
+                        return (std::uint64_t{2} << b) - 1;
+                }
+                return std::uint64_t{0};
+            };
+            stats.p50_latency_ns = percentile(0.5);
+            stats.p99_latency_ns = percentile(0.99);
+        }
+        return result;
+    }
+};
+
+constexpr std::size_t Registry::max_products;
+constexpr std::size_t Product_Counters::buckets;
+
+template <typename T>
+std::string type_name() {
+    const char* name = typeid(T).name();
+#if defined(__GNUG__)
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status == 0 && demangled) {
+        std::string result{demangled};
+        std::free(demangled);
+        return result;
+    }
+#endif
+    return name;
+}
+
+// index of the product type, registered on first use
+template <typename T>
+std::size_t product_id() {
+    static const std::size_t id =
+        Registry::instance().register_product(type_name<T>());
+    return id;
+}
+
+template <typename T>
+void record_destruction() {
+    Registry::instance().record(
+        product_id<T>(), [](Product_Counters& counters) {
+            Product_Counters::bump(counters.destroyed, 1);
+            Product_Counters::bump(counters.freed_bytes, sizeof(T));
+        });
+}
+
+#if FACTORY_INSTRUMENTATION
+// std::default_delete<T>, which also records the destruction of the type
+// make_unique() created; converts from Deleter<U> when U* converts to T*
+template <typename T>
+class Deleter {
+    template <typename U>
+    friend class Deleter;
+    void (*record_)() = nullptr; // not counted when default constructed
+
+  public:
+    constexpr Deleter() noexcept = default;
+    explicit Deleter(void (*record)()) noexcept : record_{record} {}
+    template <typename U, typename = typename std::enable_if<
+                              std::is_convertible<U*, T*>::value>::type>
+    Deleter(const Deleter<U>& other) noexcept : record_{other.record_} {}
+
+    void operator()(T* object) const {
+        static_assert(sizeof(T) > 0, "Deleter: incomplete type");
+        delete object;
+        if (record_)
+            record_();
+    }
+};
+
+template <typename T>
+using Unique_Ptr = std::unique_ptr<T, Deleter<T>>;
+
+// std::make_unique<T>(), counted and timed (allocation and construction)
+template <typename T, typename... Args>
+Unique_Ptr<T> make_unique(Args&&... args) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    Unique_Ptr<T> object{new T(std::forward<Args>(args)...),
+                         Deleter<T>{&record_destruction<T>}};
+    auto ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                             start)
+            .count());
+    Registry::instance().record(
+        product_id<T>(), [ns](Product_Counters& counters) {
+            Product_Counters::bump(counters.created, 1);
+            Product_Counters::bump(counters.bytes, sizeof(T));
+            Product_Counters::bump(counters.latency_ns, ns);
+            Product_Counters::bump(
+                counters.latency[Product_Counters::bucket(ns)], 1);
+        });
+    return object;
+}
+#else
+// the plain std::unique_ptr, the API of the factories is unchanged
+template <typename T>
+using Unique_Ptr = std::unique_ptr<T>;
+
+template <typename T, typename... Args>
+Unique_Ptr<T> make_unique(Args&&... args) {
+    return std::make_unique<T>(std::forward<Args>(args)...);
+}
+#endif // FACTORY_INSTRUMENTATION
+
+inline std::vector<Product_Stats> snapshot() {
+    return Registry::instance().snapshot();
+}
+
+// one product per line
+inline std::string to_json(const std::vector<Product_Stats>& products) {
+    std::ostringstream json;
+    json << std::setprecision(6) << "{\n  \"products\": [\n";
+    for (std::size_t i = 0; i < products.size(); ++i) {
+        const Product_Stats& stats = products[i];
+        std::string name;
+        for (char c : stats.name) {
+            if (c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+        json << "    {\"name\": \"" << name
+             << "\", \"created\": " << stats.created
+             << ", \"destroyed\": " << stats.destroyed
+             << ", \"live\": " << stats.live << ", \"bytes\": " << stats.bytes
+             << ", \"live_bytes\": " << stats.live_bytes
+             << ", \"mean_latency_ns\": " << stats.mean_latency_ns
+             << ", \"p50_latency_ns\": " << stats.p50_latency_ns
+             << ", \"p99_latency_ns\": " << stats.p99_latency_ns << '}'
+             << (i + 1 < products.size() ? "," : "") << '\n';
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+} // namespace instrumentation
+
+#endif // FACTORY_INSTRUMENTATION_H_
@@ -0,0 +1,226 @@
+// Iterator design pattern, memory-mapped (out-of-core) variant
+// iterates in place over a binary file that may be larger than the RAM
+
+// compile with g++ -std=c++14 -O2 -pthread iterator_mmap.cpp -oiterator_mmap
+// POSIX only (mmap/madvise)
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the in-memory iterable collection
+template <typename T>
+class Collection {
+    std::vector<T> data_;
+
+  public:
+    Collection(std::initializer_list<T> data) : data_{data} {}
+    template <typename InputIt>
+    Collection(InputIt first, InputIt last) : data_(first, last) {}
+    std::size_t size() const { return data_.size(); }
+    const T* begin() const { return data_.data(); }
+    const T* end() const { return data_.data() + data_.size(); }
+};
+
+// on-disk layout: a fixed header followed by size() elements of T, the
+// payload starts at a page-aligned offset so it is suitably aligned for T
+struct File_Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t element_size;
+    std::uint64_t size;
+    std::uint64_t offset;
+};
+
+constexpr char file_magic[8] = {'C', 'O', 'L', 'L', 'E', 'C', 'T', 'N'};
+constexpr std::uint32_t file_version = 1;
+
+// writes a collection in the format read by Mapped_Collection<T>
+template <typename T>
+void write_collection(const std::string& path,
+                      const Collection<T>& collection) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can be mapped");
+    File_Header header{};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version = file_version;
+    header.element_size = sizeof(T);
+    header.size = collection.size();
+    header.offset = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    if (!out)
+        throw std::runtime_error("Cannot open " + path + " for writing!");
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<char> padding(header.offset - sizeof(header), 0);
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<const char*>(collection.begin()),
+              collection.size() * sizeof(T));
+    if (!out)
+        throw std::runtime_error("Error while writing " + path + "!");
+}
+
+// read-only collection backed by a memory-mapped file, zero copies
+template <typename T>
+class Mapped_Collection {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can be mapped");
+
+    void* map_ = nullptr;
+    std::size_t map_size_ = 0;
+    const T* data_ = nullptr;
+    std::size_t size_ = 0;
+
+  public:
+    // contiguous sub-range handed to a parallel consumer
+    struct Chunk {
+        const T* first;
+        const T* last;
+        const T* begin() const { return first; }
+        const T* end() const { return last; }
+        std::size_t size() const { return last - first; }
+    };
+
+    explicit Mapped_Collection(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path + "!");
+        struct stat st {};
+        if (::fstat(fd, &st) < 0 ||
+            static_cast<std::size_t>(st.st_size) < sizeof(File_Header)) {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a collection file!");
+        }
+        map_size_ = st.st_size;
+        map_ = ::mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (map_ == MAP_FAILED)
+            throw std::runtime_error("Cannot map " + path + "!");
+
+        File_Header header;
+        std::memcpy(&header, map_, sizeof(header));
+        if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+            header.version != file_version ||
+            header.element_size != sizeof(T) ||
+            header.offset % alignof(T) != 0 ||
+            header.offset > map_size_ ||
+            // no overflow on a malformed size
+            header.size > (map_size_ - header.offset) / sizeof(T)) {
+            ::munmap(map_, map_size_);
+            throw std::runtime_error(path + " has an incompatible layout!");
+        }
+        data_ = reinterpret_cast<const T*>(static_cast<const char*>(map_) +
+                                           header.offset);
+        size_ = header.size;
+        // by default we expect a front-to-back scan
+        advise(MADV_SEQUENTIAL);
+    }
+    Mapped_Collection(Mapped_Collection&& other) noexcept
+        : map_{other.map_}, map_size_{other.map_size_}, data_{other.data_},
+          size_{other.size_} {
+        other.map_ = nullptr;
+    }
+    Mapped_Collection(const Mapped_Collection&) = delete;
+    Mapped_Collection& operator=(const Mapped_Collection&) = delete;
+    ~Mapped_Collection() {
+        if (map_)
+            ::munmap(map_, map_size_);
+    }
+
+    std::size_t size() const { return size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& operator[](std::size_t pos) const { return data_[pos]; }
+
+    // access pattern hint for the whole mapping, e.g. MADV_RANDOM
+    void advise(int advice) const { ::madvise(map_, map_size_, advice); }
+
+    // asks the kernel to start reading a range ahead of its use
+    void will_need(const Chunk& chunk) const {
+        auto page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+        auto first =
+            reinterpret_cast<std::uintptr_t>(chunk.first) & ~(page - 1);
+        auto last = reinterpret_cast<std::uintptr_t>(chunk.last);
+        ::madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED);
+    }
+
+    // splits the collection into n contiguous chunks of (almost) equal size
+    std::vector<Chunk> partition(std::size_t n) const {
+        n = std::max<std::size_t>(1, std::min(n, size_));
+        std::vector<Chunk> chunks;
+        chunks.reserve(n);
+        std::size_t q = size_ / n, r = size_ % n, pos = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            std::size_t len = q + (i < r ? 1 : 0);
+            chunks.push_back({data_ + pos, data_ + pos + len});
+            pos += len;
+        }
+        return chunks;
+    }
+};
+
+int main() {
+    const std::string path = "collection.bin";
+
+    // small round trip
+    write_collection(path, Collection<int>{0, 1, 2, 3});
+    {
+        Mapped_Collection<int> mapped{path};
+        for (auto&& elem : mapped)
+            std::cout << elem << ' ';
+        std::cout << '\n';
+    }
+
+    // larger data set, scanned in parallel straight from the page cache
+    const std::size_t N = 20'000'000;
+    {
+        std::vector<std::uint64_t> numbers(N);
+        std::iota(numbers.begin(), numbers.end(), 0);
+        write_collection(path, Collection<std::uint64_t>(numbers.begin(),
+                                                         numbers.end()));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Mapped_Collection<std::uint64_t> mapped{path};
+    std::size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+    auto chunks = mapped.partition(n_threads);
+    std::vector<std::uint64_t> partial(chunks.size(), 0);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        workers.emplace_back([&, i] {
+            mapped.will_need(chunks[i]);
+            partial[i] = std::accumulate(chunks[i].begin(), chunks[i].end(),
+                                         std::uint64_t{0});
+        });
+    }
+    for (auto&& worker : workers)
+        worker.join();
+    auto sum =
+        std::accumulate(partial.begin(), partial.end(), std::uint64_t{0});
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    std::cout << "Mapped " << mapped.size() << " elements, " << chunks.size()
+              << " chunk(s), sum " << sum << " (expected "
+              << std::uint64_t{N} * (N - 1) / 2 << ") in " << elapsed.count()
+              << " ms\n";
+
+    std::remove(path.c_str());
+}
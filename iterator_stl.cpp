@@ -0,0 +1,177 @@
+// Iterator design pattern, STL-conforming variant
+// contiguous random-access iterators usable with <algorithm>, range-for,
+// C++20 ranges and the C++17 parallel algorithms
+
+// compile with g++ -std=c++17 -O2 iterator_stl.cpp -oiterator_stl -ltbb
+// (libstdc++ uses TBB as its parallel backend whenever its headers are found)
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <execution>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+#if __cplusplus > 201703L
+#include <ranges>
+#endif
+
+// the iterable collection
+template <typename T>
+class Collection {
+    std::vector<T> data_;
+
+    // the Java-like iterator, kept for comparison
+    class Java_Iterator {
+        Collection& collection_;
+        std::size_t pos_ = 0;
+
+      public:
+        Java_Iterator(Collection& collection) : collection_{collection} {}
+        bool has_next() const { return pos_ < collection_.size(); }
+        void advance() { ++pos_; }
+        T& get() const { return collection_.data_[pos_]; }
+        void rewind() { pos_ = 0; }
+    };
+
+  public:
+    // plain pointers are contiguous random-access iterators, the loop bound
+    // is computed once and the compiler sees straight-line memory accesses
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    Collection(std::initializer_list<T> data) : data_{data} {}
+    Collection(std::size_t size, const T& value) : data_(size, value) {}
+    // iterators only, so that Collection<int>(5, 3) is 5 threes
+    template <typename InputIt,
+              typename = std::enable_if_t<std::is_convertible<
+                  typename std::iterator_traits<InputIt>::iterator_category,
+                  std::input_iterator_tag>::value>>
+    Collection(InputIt first, InputIt last) : data_(first, last) {}
+
+    std::size_t size() const { return data_.size(); }
+    T* data() { return data_.data(); }
+    const T* data() const { return data_.data(); }
+
+    iterator begin() { return data_.data(); }
+    iterator end() { return data_.data() + data_.size(); }
+    const_iterator begin() const { return data_.data(); }
+    const_iterator end() const { return data_.data() + data_.size(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    Java_Iterator first() { return *this; }
+
+    // algorithms parameterized by an execution policy, e.g.
+    // std::execution::seq, par or par_unseq (unseq is C++20)
+    template <typename Policy, typename F>
+    void for_each(Policy&& policy, F f) {
+        std::for_each(std::forward<Policy>(policy), begin(), end(), f);
+    }
+    // in-place transform
+    template <typename Policy, typename F>
+    void transform(Policy&& policy, F f) {
+        std::transform(std::forward<Policy>(policy), begin(), end(), begin(),
+                       f);
+    }
+    template <typename Policy, typename U, typename BinaryOp = std::plus<>>
+    U reduce(Policy&& policy, U init, BinaryOp op = {}) const {
+        return std::reduce(std::forward<Policy>(policy), begin(), end(), init,
+                           op);
+    }
+};
+
+#if __cplusplus > 201703L
+static_assert(std::ranges::contiguous_range<Collection<int>>);
+static_assert(std::ranges::sized_range<Collection<int>>);
+static_assert(std::contiguous_iterator<Collection<int>::iterator>);
+#endif
+static_assert(std::is_same<std::iterator_traits<Collection<int>::iterator>::
+                               iterator_category,
+                           std::random_access_iterator_tag>::value,
+              "Collection<T>::iterator must be random-access");
+
+// times f(), returns milliseconds
+template <typename F>
+double time_ms(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main() {
+    Collection<int> collection{0, 1, 2, 3};
+
+    // range-for
+    for (auto& element : collection) {
+        std::cout << element << ' ';
+        element = collection.size() - 1 - element;
+    }
+    std::cout << '\n';
+
+    // a size and a value, not an iterator range
+    Collection<int> threes(5, 3);
+    std::cout << "Collection<int>(5, 3) has " << threes.size()
+              << " elements\n";
+
+    // standard algorithms
+    std::sort(collection.begin(), collection.end());
+    std::copy(collection.begin(), collection.end(),
+              std::ostream_iterator<int>(std::cout, " "));
+    std::cout << '\n';
+
+    // benchmark, sum of squares over a large collection
+    const std::size_t N = 50'000'000;
+    Collection<unsigned long> numbers(N, 0);
+    std::iota(numbers.begin(), numbers.end(), 0);
+    unsigned long result = 0;
+
+    std::cout << "Sum of squares over " << N << " elements\n";
+    auto java_ms = time_ms([&] {
+        unsigned long sum = 0;
+        for (auto iter = numbers.first(); iter.has_next(); iter.advance())
+            sum += iter.get() * iter.get();
+        result = sum;
+    });
+    std::cout << "\tJava-like iterator:   " << java_ms << " ms (" << result
+              << ")\n";
+
+    auto range_ms = time_ms([&] {
+        unsigned long sum = 0;
+        for (auto elem : numbers)
+            sum += elem * elem;
+        result = sum;
+    });
+    std::cout << "\trange-for:            " << range_ms << " ms (" << result
+              << ")\n";
+
+    auto seq_ms = time_ms([&] {
+        result = std::transform_reduce(
+            std::execution::seq, numbers.begin(), numbers.end(), 0UL,
+            std::plus<>{}, [](unsigned long x) { return x * x; });
+    });
+    std::cout << "\ttransform_reduce seq: " << seq_ms << " ms (" << result
+              << ")\n";
+
+    auto par_ms = time_ms([&] {
+        result = std::transform_reduce(
+            std::execution::par_unseq, numbers.begin(), numbers.end(), 0UL,
+            std::plus<>{}, [](unsigned long x) { return x * x; });
+    });
+    std::cout << "\ttransform_reduce par: " << par_ms << " ms (" << result
+              << ")\n";
+
+    // the helpers
+    numbers.transform(std::execution::par_unseq,
+                      [](unsigned long x) { return x % 7; });
+    numbers.for_each(std::execution::par_unseq,
+                     [](unsigned long& x) { x *= 2; });
+    std::cout << "Reduced: " << numbers.reduce(std::execution::par_unseq, 0UL)
+              << '\n';
+}
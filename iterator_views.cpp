@@ -0,0 +1,327 @@
+// Iterator design pattern, lazy adapter chains (filter/map/zip/take)
+// the adapters wrap the collection's iterator and fuse into a single pass,
+// no intermediate storage is ever created
+
+// compile with g++ -std=c++14 -O2 iterator_views.cpp -oiterator_views
+// run as ./iterator_views [number_of_elements], default 10M
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// size information passed along the chain, exact or an upper bound
+struct Size_Hint {
+    std::size_t size;
+    bool exact;
+};
+
+template <typename Base, typename F>
+class Filter_View;
+template <typename Base, typename F>
+class Map_View;
+template <typename Base>
+class Take_View;
+template <typename Base1, typename Base2>
+class Zip_View;
+
+// fluent interface shared by all views (CRTP)
+template <typename Derived>
+class View {
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+
+  public:
+    template <typename F>
+    Filter_View<Derived, F> filter(F f) const {
+        return {self(), std::move(f)};
+    }
+    template <typename F>
+    Map_View<Derived, F> map(F f) const {
+        return {self(), std::move(f)};
+    }
+    Take_View<Derived> take(std::size_t n) const { return {self(), n}; }
+    template <typename Other>
+    Zip_View<Derived, Other> zip(const Other& other) const {
+        return {self(), other};
+    }
+
+    // single fused pass
+    template <typename F>
+    void for_each(F f) const {
+        for (auto it = self().begin(), last = self().end(); it != last; ++it)
+            f(*it);
+    }
+    // the only place where storage is allocated, sized up front if possible
+    auto to_vector() const {
+        using value_type = std::decay_t<decltype(*self().begin())>;
+        std::vector<value_type> result;
+        auto hint = self().size_hint();
+        if (hint.exact)
+            result.reserve(hint.size);
+        for_each([&](auto&& elem) { result.push_back(elem); });
+        return result;
+    }
+};
+
+// view over a pair of iterators, the root of every chain
+template <typename It>
+class Range_View : public View<Range_View<It>> {
+    It first_, last_;
+
+  public:
+    Range_View(It first, It last) : first_{first}, last_{last} {}
+    It begin() const { return first_; }
+    It end() const { return last_; }
+    Size_Hint size_hint() const {
+        return {static_cast<std::size_t>(std::distance(first_, last_)), true};
+    }
+};
+
+// keeps the elements satisfying f, size becomes an upper bound
+template <typename Base, typename F>
+class Filter_View : public View<Filter_View<Base, F>> {
+    Base base_;
+    F f_;
+
+    using base_iterator = decltype(std::declval<const Base&>().begin());
+
+  public:
+    class iterator {
+        base_iterator it_, last_;
+        const F* f_;
+
+        void skip() {
+            while (it_ != last_ && !(*f_)(*it_))
+                ++it_;
+        }
+
+      public:
+        iterator(base_iterator it, base_iterator last, const F* f)
+            : it_{it}, last_{last}, f_{f} {
+            skip();
+        }
+        decltype(auto) operator*() const { return *it_; }
+        iterator& operator++() {
+            ++it_;
+            skip();
+            return *this;
+        }
+        bool operator==(const iterator& rhs) const { return it_ == rhs.it_; }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    Filter_View(Base base, F f) : base_{std::move(base)}, f_{std::move(f)} {}
+    iterator begin() const { return {base_.begin(), base_.end(), &f_}; }
+    iterator end() const { return {base_.end(), base_.end(), &f_}; }
+    Size_Hint size_hint() const { return {base_.size_hint().size, false}; }
+};
+
+// applies f to every element, size is preserved
+template <typename Base, typename F>
+class Map_View : public View<Map_View<Base, F>> {
+    Base base_;
+    F f_;
+
+    using base_iterator = decltype(std::declval<const Base&>().begin());
+
+  public:
+    class iterator {
+        base_iterator it_;
+        const F* f_;
+
+      public:
+        iterator(base_iterator it, const F* f) : it_{it}, f_{f} {}
+        decltype(auto) operator*() const { return (*f_)(*it_); }
+        iterator& operator++() {
+            ++it_;
+            return *this;
+        }
+        bool operator==(const iterator& rhs) const { return it_ == rhs.it_; }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    Map_View(Base base, F f) : base_{std::move(base)}, f_{std::move(f)} {}
+    iterator begin() const { return {base_.begin(), &f_}; }
+    iterator end() const { return {base_.end(), &f_}; }
+    Size_Hint size_hint() const { return base_.size_hint(); }
+};
+
+// first n elements, stops pulling from the chain once n are produced
+template <typename Base>
+class Take_View : public View<Take_View<Base>> {
+    Base base_;
+    std::size_t n_;
+
+    using base_iterator = decltype(std::declval<const Base&>().begin());
+
+  public:
+    class iterator {
+        base_iterator it_;
+        std::size_t remaining_;
+
+      public:
+        iterator(base_iterator it, std::size_t remaining)
+            : it_{it}, remaining_{remaining} {}
+        decltype(auto) operator*() const { return *it_; }
+        // the base is not advanced past the n-th element, so a filter
+        // underneath does not scan on for an element nobody reads
+        iterator& operator++() {
+            if (--remaining_ != 0)
+                ++it_;
+            return *this;
+        }
+        // the end iterator has nothing remaining, or the chain is exhausted
+        bool operator==(const iterator& rhs) const {
+            return remaining_ == rhs.remaining_ || it_ == rhs.it_;
+        }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    Take_View(Base base, std::size_t n) : base_{std::move(base)}, n_{n} {}
+    iterator begin() const { return {base_.begin(), n_}; }
+    iterator end() const { return {base_.end(), 0}; }
+    Size_Hint size_hint() const {
+        auto hint = base_.size_hint();
+        // an upper bound stays one: the base may run out before n
+        return {std::min(hint.size, n_), hint.exact};
+    }
+};
+
+// pairs up elements of two chains, stops at the end of the shorter one
+template <typename Base1, typename Base2>
+class Zip_View : public View<Zip_View<Base1, Base2>> {
+    Base1 base1_;
+    Base2 base2_;
+
+    using iterator1 = decltype(std::declval<const Base1&>().begin());
+    using iterator2 = decltype(std::declval<const Base2&>().begin());
+
+  public:
+    class iterator {
+        iterator1 it1_;
+        iterator2 it2_;
+
+      public:
+        iterator(iterator1 it1, iterator2 it2) : it1_{it1}, it2_{it2} {}
+        auto operator*() const {
+            return std::pair<std::decay_t<decltype(*it1_)>,
+                             std::decay_t<decltype(*it2_)>>{*it1_, *it2_};
+        }
+        iterator& operator++() {
+            ++it1_;
+            ++it2_;
+            return *this;
+        }
+        bool operator==(const iterator& rhs) const {
+            return it1_ == rhs.it1_ || it2_ == rhs.it2_;
+        }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    Zip_View(Base1 base1, Base2 base2)
+        : base1_{std::move(base1)}, base2_{std::move(base2)} {}
+    iterator begin() const { return {base1_.begin(), base2_.begin()}; }
+    iterator end() const { return {base1_.end(), base2_.end()}; }
+    Size_Hint size_hint() const {
+        auto hint1 = base1_.size_hint(), hint2 = base2_.size_hint();
+        return {std::min(hint1.size, hint2.size), hint1.exact && hint2.exact};
+    }
+};
+
+// the iterable collection
+template <typename T>
+class Collection {
+    std::vector<T> data_;
+
+  public:
+    Collection(std::initializer_list<T> data) : data_{data} {}
+    explicit Collection(std::vector<T> data) : data_{std::move(data)} {}
+    std::size_t size() const { return data_.size(); }
+    const T* begin() const { return data_.data(); }
+    const T* end() const { return data_.data() + data_.size(); }
+
+    // entry point of a lazy chain, the view only refers to the data
+    Range_View<const T*> view() const { return {begin(), end()}; }
+};
+
+int main(int argc, char** argv) {
+    Collection<int> collection{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    Collection<char> letters{'a', 'b', 'c', 'd', 'e'};
+
+    auto pipeline = collection.view()
+                        .filter([](int x) { return x % 2 == 1; })
+                        .map([](int x) { return x * x; })
+                        .take(3);
+    for (auto&& elem : pipeline)
+        std::cout << elem << ' ';
+    std::cout << '\n';
+
+    // 5 odd elements, asked for 8: the hint is a bound, not an exact size
+    auto short_take = collection.view()
+                          .filter([](int x) { return x % 2 == 1; })
+                          .take(8);
+    auto hint = short_take.size_hint();
+    std::cout << "take(8) of a filter: size hint " << hint.size
+              << (hint.exact ? " (exact)" : " (upper bound)") << ", "
+              << short_take.to_vector().size() << " elements\n";
+
+    // the chain stops pulling at the 3rd element: 6 tests, not 10
+    std::size_t tests = 0;
+    collection.view()
+        .filter([&](int x) { return ++tests, x % 2 == 1; })
+        .take(3)
+        .for_each([](int) {});
+    std::cout << "take(3) of a filter tested " << tests << " elements\n";
+
+    for (auto&& elem : collection.view().zip(letters.view()).to_vector())
+        std::cout << '(' << elem.first << ", " << elem.second << ") ";
+    std::cout << '\n';
+
+    // benchmark, eager (one vector per stage) versus lazy (single pass)
+    std::size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    std::vector<long> numbers(N);
+    std::iota(numbers.begin(), numbers.end(), 0);
+    Collection<long> big{std::move(numbers)};
+    const std::size_t n_take = N / 4;
+    auto is_even = [](long x) { return x % 2 == 0; };
+    auto scale = [](long x) { return 3 * x + 1; };
+
+    using clock = std::chrono::steady_clock;
+    std::chrono::duration<double, std::milli> eager_ms{}, lazy_ms{};
+    long eager_sum = 0, lazy_sum = 0;
+    std::size_t eager_bytes = 0;
+
+    auto start = clock::now();
+    {
+        std::vector<long> filtered;
+        std::copy_if(big.begin(), big.end(), std::back_inserter(filtered),
+                     is_even);
+        std::vector<long> mapped(filtered.size());
+        std::transform(filtered.begin(), filtered.end(), mapped.begin(),
+                       scale);
+        std::vector<long> taken(
+            mapped.begin(), mapped.begin() + std::min(n_take, mapped.size()));
+        eager_sum = std::accumulate(taken.begin(), taken.end(), 0L);
+        eager_bytes = (filtered.capacity() + mapped.capacity() +
+                       taken.capacity()) * sizeof(long);
+    }
+    eager_ms = clock::now() - start;
+
+    start = clock::now();
+    big.view().filter(is_even).map(scale).take(n_take).for_each(
+        [&](long x) { lazy_sum += x; });
+    lazy_ms = clock::now() - start;
+
+    std::cout << "filter/map/take over " << N << " elements\n";
+    std::cout << "\teager: " << eager_ms.count() << " ms, " << eager_bytes
+              << " bytes of intermediates (" << eager_sum << ")\n";
+    std::cout << "\tlazy:  " << lazy_ms.count() << " ms, 0 bytes of "
+              << "intermediates (" << lazy_sum << ")\n";
+}
@@ -0,0 +1,255 @@
+// Method chaining design pattern, columnar bulk variant
+// rows are appended in place into separate name/age columns, names are
+// interned once in a string arena and referred to by a 32-bit id
+
+// compile with
+// g++ -std=c++14 -O2 method_chaining_table.cpp -omethod_chaining_table
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// row-wise person, as in method_chaining.cpp
+class Person {
+    std::string name_;
+    unsigned age_;
+
+  public:
+    Person() : name_{}, age_{} {}
+    Person& name(std::string name) {
+        name_ = std::move(name);
+        return *this;
+    }
+    Person& age(unsigned age) {
+        age_ = age;
+        return *this;
+    }
+    const std::string& get_name() const { return name_; }
+    unsigned get_age() const { return age_; }
+    friend std::ostream& operator<<(std::ostream& os, const Person& rhs) {
+        return os << rhs.name_ << " " << rhs.age_;
+    }
+};
+
+// stores every distinct string once, contiguously, and hands out ids
+class String_Arena {
+    std::vector<char> chars_{};            // null-terminated strings
+    std::vector<std::uint32_t> offsets_{}; // id -> offset into chars_
+    // open addressing hash table of id + 1, 0 marks an empty slot
+    std::vector<std::uint32_t> slots_ = std::vector<std::uint32_t>(64, 0);
+
+    static std::size_t hash(const char* str, std::size_t len) {
+        std::size_t h = 14695981039346656037ULL; // FNV-1a
+        for (std::size_t i = 0; i < len; ++i)
+            h = (h ^ static_cast<unsigned char>(str[i])) * 1099511628211ULL;
+        return h;
+    }
+    bool equal(std::uint32_t id, const char* str, std::size_t len) const {
+        const char* stored = c_str(id);
+        return std::strncmp(stored, str, len) == 0 && stored[len] == '\0';
+    }
+    void grow() {
+        std::vector<std::uint32_t> slots(slots_.size() * 2, 0);
+        std::size_t mask = slots.size() - 1;
+        for (std::uint32_t id = 0; id < offsets_.size(); ++id) {
+            const char* str = c_str(id);
+            std::size_t pos = hash(str, std::strlen(str)) & mask;
+            while (slots[pos])
+                pos = (pos + 1) & mask;
+            slots[pos] = id + 1;
+        }
+        slots_ = std::move(slots);
+    }
+
+  public:
+    // id of str, adds it to the arena the first time it is seen
+    std::uint32_t intern(const char* str, std::size_t len) {
+        if (2 * (offsets_.size() + 1) > slots_.size())
+            grow();
+        std::size_t mask = slots_.size() - 1;
+        std::size_t pos = hash(str, len) & mask;
+        while (slots_[pos]) {
+            if (equal(slots_[pos] - 1, str, len))
+                return slots_[pos] - 1;
+            pos = (pos + 1) & mask;
+        }
+        auto id = static_cast<std::uint32_t>(offsets_.size());
+        offsets_.push_back(static_cast<std::uint32_t>(chars_.size()));
+        chars_.insert(chars_.end(), str, str + len);
+        chars_.push_back('\0');
+        slots_[pos] = id + 1;
+        return id;
+    }
+    std::uint32_t intern(const std::string& str) {
+        return intern(str.data(), str.size());
+    }
+    // id of an already interned string, or size() if there is none
+    std::uint32_t find(const std::string& str) const {
+        std::size_t mask = slots_.size() - 1;
+        std::size_t pos = hash(str.data(), str.size()) & mask;
+        while (slots_[pos]) {
+            if (equal(slots_[pos] - 1, str.data(), str.size()))
+                return slots_[pos] - 1;
+            pos = (pos + 1) & mask;
+        }
+        return static_cast<std::uint32_t>(size());
+    }
+    const char* c_str(std::uint32_t id) const {
+        return chars_.data() + offsets_[id];
+    }
+    std::size_t size() const { return offsets_.size(); }
+};
+
+// column-oriented table of persons
+class PersonTable {
+    String_Arena names_{};
+    std::vector<std::uint32_t> name_ids_{};
+    std::vector<unsigned> ages_{};
+
+  public:
+    // writes the fields of a freshly appended row in place
+    class Row {
+        PersonTable& table_;
+        std::size_t row_;
+
+      public:
+        Row(PersonTable& table, std::size_t row) : table_{table}, row_{row} {}
+        Row& name(const std::string& name) {
+            table_.name_ids_[row_] = table_.names_.intern(name);
+            return *this;
+        }
+        Row& name(const char* name) {
+            table_.name_ids_[row_] =
+                table_.names_.intern(name, std::strlen(name));
+            return *this;
+        }
+        Row& age(unsigned age) {
+            table_.ages_[row_] = age;
+            return *this;
+        }
+    };
+
+    // whole-column operations, chained
+    class Bulk {
+        PersonTable& table_;
+
+      public:
+        explicit Bulk(PersonTable& table) : table_{table} {}
+        Bulk& increment_age(unsigned by = 1) {
+            for (auto& age : table_.ages_)
+                age += by;
+            return *this;
+        }
+        Bulk& clamp_age(unsigned lo, unsigned hi) {
+            for (auto& age : table_.ages_)
+                age = std::min(std::max(age, lo), hi);
+            return *this;
+        }
+        // renaming touches only 32-bit ids, never the strings themselves
+        Bulk& rename(const std::string& from, const std::string& to) {
+            auto from_id = table_.names_.find(from);
+            if (from_id == table_.names_.size())
+                return *this;
+            auto to_id = table_.names_.intern(to);
+            for (auto& id : table_.name_ids_)
+                id = id == from_id ? to_id : id;
+            return *this;
+        }
+    };
+
+    PersonTable() { names_.intern("", 0); } // id 0 is the empty name
+
+    void reserve(std::size_t rows) {
+        name_ids_.reserve(rows);
+        ages_.reserve(rows);
+    }
+    // appends an empty row (no name, age 0)
+    Row add() {
+        name_ids_.push_back(0);
+        ages_.push_back(0);
+        return {*this, ages_.size() - 1};
+    }
+    Bulk bulk() { return Bulk{*this}; }
+
+    std::size_t size() const { return ages_.size(); }
+    std::size_t distinct_names() const { return names_.size() - 1; }
+    const char* name(std::size_t row) const {
+        return names_.c_str(name_ids_[row]);
+    }
+    unsigned age(std::size_t row) const { return ages_[row]; }
+
+    // scans
+    std::size_t count_name(const std::string& name) const {
+        auto id = names_.find(name);
+        return std::count(name_ids_.begin(), name_ids_.end(), id);
+    }
+    std::uint64_t total_age() const {
+        std::uint64_t sum = 0;
+        for (auto age : ages_)
+            sum += age;
+        return sum;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const PersonTable& rhs) {
+        for (std::size_t i = 0; i < rhs.size(); ++i)
+            os << rhs.name(i) << " " << rhs.age(i) << '\n';
+        return os;
+    }
+};
+
+int main() {
+    PersonTable table;
+    table.add().name("John").age(35);
+    table.add().name("Jane").age(31);
+    table.add().age(7).name("John");
+    table.bulk().increment_age().rename("John", "Johnny");
+    std::cout << table << '\n';
+
+    // ingest and scan benchmark, row-wise versus columnar
+    const std::size_t N = 5000000, distinct = 1000;
+    std::vector<std::string> pool;
+    for (std::size_t i = 0; i < distinct; ++i)
+        pool.push_back("person_with_a_long_name_" + std::to_string(i));
+    using clock = std::chrono::steady_clock;
+    std::chrono::duration<double, std::milli> ms;
+
+    auto start = clock::now();
+    std::vector<Person> rows(N);
+    for (std::size_t i = 0; i < N; ++i)
+        rows[i].name(pool[i % distinct]).age(i % 100);
+    ms = clock::now() - start;
+    std::cout << "std::vector<Person> ingest: " << ms.count() << " ms\n";
+
+    start = clock::now();
+    PersonTable columns;
+    columns.reserve(N);
+    for (std::size_t i = 0; i < N; ++i)
+        columns.add().name(pool[i % distinct]).age(i % 100);
+    ms = clock::now() - start;
+    std::cout << "PersonTable ingest:         " << ms.count() << " ms ("
+              << columns.distinct_names() << " distinct names)\n";
+
+    start = clock::now();
+    std::uint64_t sum = 0;
+    std::size_t count = 0;
+    for (auto&& person : rows) {
+        sum += person.get_age();
+        count += person.get_name() == pool[42];
+    }
+    ms = clock::now() - start;
+    std::cout << "std::vector<Person> scan:   " << ms.count() << " ms (" << sum
+              << ", " << count << ")\n";
+
+    start = clock::now();
+    sum = columns.total_age();
+    count = columns.count_name(pool[42]);
+    ms = clock::now() - start;
+    std::cout << "PersonTable scan:           " << ms.count() << " ms (" << sum
+              << ", " << count << ")\n";
+}
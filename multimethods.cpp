@@ -0,0 +1,578 @@
+// Open multimethods, N-ary dispatch without hand-written overloads
+// free functions are registered for tuples of concrete types, at startup the
+// library resolves the most specific function for every combination of
+// classes (using the class hierarchy) and compresses the result into one
+// dense table; a call costs O(arity) indexed loads plus one indirect call
+// classes are identified through a perfect hash of their std::type_info
+
+// compile with g++ -std=c++14 -O2 multimethods.cpp -omultimethods
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include "bench/bench.h"
+
+// the classes multimethods can dispatch on, with their direct bases
+class Hierarchy {
+    struct Class {
+        const std::type_info* type;
+        std::vector<std::size_t> bases;
+    };
+    std::vector<Class> _classes{};
+    // _is_a[c][d]: class c is d or derives from it
+    std::vector<std::vector<bool>> _is_a{};
+
+    // perfect hash of the type_info addresses, built by seal()
+    struct Slot {
+        const std::type_info* type;
+        std::size_t index;
+    };
+    std::uint64_t _multiplier = 0;
+    unsigned _shift = 64;
+    std::vector<Slot> _slots{};
+    bool _sealed = false;
+    std::size_t _version = 0; // bumped by every add()
+
+    std::size_t slot(const std::type_info& type) const {
+        return (reinterpret_cast<std::uintptr_t>(&type) * _multiplier) >>
+               _shift;
+    }
+
+    std::size_t find(const std::type_info& type) const {
+        for (std::size_t i = 0; i < _classes.size(); ++i)
+            if (*_classes[i].type == type)
+                return i;
+        throw std::invalid_argument(std::string{"Hierarchy: unknown class "} +
+                                    type.name());
+    }
+
+  public:
+    // registers T, its direct bases must be registered first
+    template <typename T, typename... Bases>
+    void add() {
+        static_assert(std::is_polymorphic<T>::value,
+                      "Hierarchy: classes must be polymorphic");
+        // twice the same class and seal() would never find a perfect hash
+        for (auto&& known : _classes)
+            if (*known.type == typeid(T))
+                throw std::logic_error(
+                    std::string{"Hierarchy: class registered twice "} +
+                    typeid(T).name());
+        _classes.push_back({&typeid(T), {find(typeid(Bases))...}});
+        _sealed = false;
+        ++_version;
+    }
+
+    std::size_t size() const { return _classes.size(); }
+    std::size_t version() const { return _version; }
+    bool is_a(std::size_t derived, std::size_t base) const {
+        return _is_a[derived][base];
+    }
+    std::size_t index(const std::type_info& type) const {
+        return _sealed ? fast_index(type) : find(type);
+    }
+
+    // index of the dynamic class, one slot load after the vptr once sealed
+    std::size_t fast_index(const std::type_info& type) const {
+        if (!_sealed)
+            return find(type);
+        const Slot& s = _slots[slot(type)];
+        if (s.type == &type)
+            return s.index;
+        return find(type); // type_info not unique, or class not registered
+    }
+
+    // computes the subclass relation and the perfect hash, idempotent
+    void seal() {
+        if (_sealed)
+            return;
+        const std::size_t n = _classes.size();
+        _is_a.assign(n, std::vector<bool>(n, false));
+        for (std::size_t c = 0; c < n; ++c) { // bases precede derived classes
+            _is_a[c][c] = true;
+            for (auto base : _classes[c].bases)
+                for (std::size_t d = 0; d < n; ++d)
+                    if (_is_a[base][d])
+                        _is_a[c][d] = true;
+        }
+
+        // multiply-shift hash, grow the table until a random multiplier
+        // without collisions turns up
+        std::mt19937_64 gen{n};
+        for (unsigned bits = 1;; ++bits) {
+            if ((std::size_t{1} << bits) < n)
+                continue;
+            _shift = 64 - bits;
+            for (int attempt = 0; attempt < 1000; ++attempt) {
+                _multiplier = gen() | 1;
+                _slots.assign(std::size_t{1} << bits, Slot{nullptr, 0});
+                bool collision = false;
+                for (std::size_t c = 0; c < n && !collision; ++c) {
+                    Slot& s = _slots[slot(*_classes[c].type)];
+                    collision = s.type != nullptr;
+                    s = {_classes[c].type, c};
+                }
+                if (!collision) {
+                    _sealed = true;
+                    return;
+                }
+            }
+        }
+    }
+};
+
+template <typename Signature>
+class Multimethod;
+
+// R(const Base1&, const Base2&, ...), every argument is dispatched on
+template <typename R, typename... Args>
+class Multimethod<R(Args...)> {
+    static_assert(sizeof...(Args) > 0, "Multimethod: no arguments");
+    static constexpr std::size_t arity = sizeof...(Args);
+
+    using Erased = void (*)();
+    using Call = R (*)(Erased, Args...);
+
+    struct Overload {
+        std::vector<std::size_t> params; // class index per argument
+        Erased function;
+        Call call;
+    };
+    struct Entry {
+        Erased function;
+        Call call;
+    };
+
+    Hierarchy& _hierarchy;
+    std::vector<Overload> _overloads{};
+    // per argument and class: group of the class times the table stride
+    std::vector<std::size_t> _offsets[arity];
+    std::vector<Entry> _table{};
+    std::size_t _built_version = 0; // of the hierarchy, as of build()
+
+    template <typename... Ps>
+    static R trampoline(Erased function, Args... args) {
+        return reinterpret_cast<R (*)(Ps...)>(function)(
+            static_cast<Ps>(args)...);
+    }
+    template <typename F, F f, typename... Ps>
+    static R direct(Erased, Args... args) {
+        return f(static_cast<Ps>(args)...);
+    }
+    template <typename F, F f, typename... Ps>
+    void add_direct(R (*)(Ps...)) {
+        static_assert(sizeof...(Ps) == arity, "Multimethod: wrong arity");
+        _overloads.push_back({{_hierarchy.index(typeid(std::decay_t<Ps>))...},
+                              nullptr,
+                              &direct<F, f, Ps...>});
+        _table.clear();
+    }
+    static R not_implemented(Erased, Args...) {
+        throw std::runtime_error("Multimethod: no function for these types");
+    }
+    static R ambiguous(Erased, Args...) {
+        throw std::runtime_error("Multimethod: ambiguous call");
+    }
+
+    // o is at least as specific as p in every argument
+    bool dominates(const Overload& o, const Overload& p) const {
+        for (std::size_t i = 0; i < arity; ++i)
+            if (!_hierarchy.is_a(o.params[i], p.params[i]))
+                return false;
+        return true;
+    }
+
+  public:
+    explicit Multimethod(Hierarchy& hierarchy) : _hierarchy{hierarchy} {}
+
+    // registers f, its parameters must be references to registered classes
+    // derived from (or equal to) the corresponding Args (no virtual bases)
+    template <typename... Ps>
+    void add(R (*f)(Ps...)) {
+        static_assert(sizeof...(Ps) == arity, "Multimethod: wrong arity");
+        _overloads.push_back({{_hierarchy.index(typeid(std::decay_t<Ps>))...},
+                              reinterpret_cast<Erased>(f),
+                              &trampoline<Ps...>});
+        _table.clear();
+    }
+    // same, but f is known at compile time and called directly, a dispatch
+    // then costs one indirect call instead of two
+    // (use as add<decltype(&f), &f>())
+    template <typename F, F f>
+    void add() {
+        add_direct<F, f>(f);
+    }
+
+    // resolves every class combination, call before dispatching
+    // (again after adding classes to the hierarchy)
+    void build() {
+        _hierarchy.seal();
+        _built_version = _hierarchy.version();
+        const std::size_t n_classes = _hierarchy.size();
+        const std::size_t n_overloads = _overloads.size();
+
+        // group the classes per argument by the set of overloads that
+        // accept them; classes of one group behave identically there
+        std::vector<std::vector<std::vector<bool>>> group_sets(arity);
+        std::size_t stride = 1;
+        for (std::size_t i = 0; i < arity; ++i) {
+            std::map<std::vector<bool>, std::size_t> groups;
+            std::vector<std::size_t> group_of(n_classes);
+            for (std::size_t c = 0; c < n_classes; ++c) {
+                std::vector<bool> accepted(n_overloads);
+                for (std::size_t o = 0; o < n_overloads; ++o)
+                    accepted[o] = _hierarchy.is_a(c, _overloads[o].params[i]);
+                auto found = groups.emplace(accepted, groups.size()).first;
+                group_of[c] = found->second;
+            }
+            group_sets[i].resize(groups.size());
+            for (auto&& group : groups)
+                group_sets[i][group.second] = group.first;
+            _offsets[i].resize(n_classes);
+            for (std::size_t c = 0; c < n_classes; ++c)
+                _offsets[i][c] = group_of[c] * stride;
+            stride *= groups.size();
+        }
+
+        // one entry per combination of groups
+        _table.assign(stride, Entry{nullptr, &not_implemented});
+        for (std::size_t cell = 0; cell < stride; ++cell) {
+            std::vector<std::size_t> applicable;
+            for (std::size_t o = 0; o < n_overloads; ++o) {
+                bool accepted = true;
+                std::size_t rest = cell;
+                for (std::size_t i = 0; i < arity && accepted; ++i) {
+                    std::size_t group = rest % group_sets[i].size();
+                    rest /= group_sets[i].size();
+                    accepted = group_sets[i][group][o];
+                }
+                if (accepted)
+                    applicable.push_back(o);
+            }
+            // most specific: applicable and not dominated by another one
+            std::vector<std::size_t> best;
+            for (auto o : applicable)
+                if (std::none_of(applicable.begin(), applicable.end(),
+                                 [&](std::size_t p) {
+                                     return p != o &&
+                                            dominates(_overloads[p],
+                                                      _overloads[o]) &&
+                                            !dominates(_overloads[o],
+                                                       _overloads[p]);
+                                 }))
+                    best.push_back(o);
+            if (best.size() == 1)
+                _table[cell] = {_overloads[best[0]].function,
+                                _overloads[best[0]].call};
+            else if (best.size() > 1)
+                _table[cell] = {nullptr, &ambiguous};
+        }
+    }
+
+    std::size_t table_size() const { return _table.size(); }
+
+    R operator()(Args... args) const {
+        // the offsets only cover the classes known to build()
+        if (_table.empty() || _built_version != _hierarchy.version())
+            throw std::logic_error("Multimethod: not built, call build()");
+        std::size_t cell = 0, i = 0;
+        using expand = int[];
+        (void) expand{0, (cell += _offsets[i++][_hierarchy.fast_index(
+                              typeid(args))],
+                          0)...};
+        const Entry& entry = _table[cell];
+        return entry.call(entry.function, args...);
+    }
+};
+
+// the animals of double_dispatch1.cpp and double_dispatch2.cpp, plus a
+// subclass that inherits the interactions of its base
+struct IAnimal {
+    virtual std::string name() const = 0;
+    virtual ~IAnimal() = default;
+};
+class Cat : public IAnimal {
+  public:
+    std::string name() const override { return "Cat"; }
+};
+class Dog : public IAnimal {
+  public:
+    std::string name() const override { return "Dog"; }
+};
+class Bird : public IAnimal {
+  public:
+    std::string name() const override { return "Bird"; }
+};
+class Kitten : public Cat {
+  public:
+    std::string name() const override { return "Kitten"; }
+};
+class Puppy : public Dog {
+  public:
+    std::string name() const override { return "Puppy"; }
+};
+
+// one function per interaction, none of the classes is touched
+void any_any(const IAnimal& first, const IAnimal& second) {
+    std::cout << first.name() << " ignores " << second.name() << '\n';
+}
+void cat_dog(const Cat& cat, const Dog& dog) {
+    std::cout << cat.name() << " plays with " << dog.name() << '\n';
+}
+void dog_cat(const Dog& dog, const Cat& cat) { cat_dog(cat, dog); }
+void cat_bird(const Cat& cat, const Bird& bird) {
+    std::cout << cat.name() << " chases " << bird.name() << '\n';
+}
+void kitten_dog(const Kitten& kitten, const Dog& dog) {
+    std::cout << kitten.name() << " hides from " << dog.name() << '\n';
+}
+void any_cat(const IAnimal& animal, const Cat& cat) {
+    std::cout << animal.name() << " sniffs " << cat.name() << '\n';
+}
+void cat_any(const Cat& cat, const IAnimal& animal) {
+    std::cout << cat.name() << " stares at " << animal.name() << '\n';
+}
+
+// three arguments
+void trio(const IAnimal&, const IAnimal&, const IAnimal&) {
+    std::cout << "Three animals\n";
+}
+void trio_birds(const Bird&, const Bird&, const Bird&) {
+    std::cout << "A flock of birds\n";
+}
+
+// benchmark copies, as in bench/bench_dispatch.cpp
+namespace double_dispatch1 {
+class Cat;
+class Dog;
+class Bird;
+struct IAnimal {
+    virtual int play(const IAnimal&) const = 0;
+    virtual int play(const Cat&) const = 0;
+    virtual int play(const Dog&) const = 0;
+    virtual int play(const Bird&) const = 0;
+    virtual ~IAnimal() = default;
+};
+class Cat : public IAnimal {
+  public:
+    int play(const IAnimal& animal) const override {
+        return animal.play(*this);
+    }
+    int play(const Cat&) const override { return 1; }
+    int play(const Dog&) const override { return 2; }
+    int play(const Bird&) const override { return 3; }
+};
+class Dog : public IAnimal {
+  public:
+    int play(const IAnimal& animal) const override {
+        return animal.play(*this);
+    }
+    int play(const Cat&) const override { return 4; }
+    int play(const Dog&) const override { return 5; }
+    int play(const Bird&) const override { return 6; }
+};
+class Bird : public IAnimal {
+  public:
+    int play(const IAnimal& animal) const override {
+        return animal.play(*this);
+    }
+    int play(const Cat&) const override { return 7; }
+    int play(const Dog&) const override { return 8; }
+    int play(const Bird&) const override { return 9; }
+};
+} // namespace double_dispatch1
+
+namespace double_dispatch2 {
+using FPTR = int (*)(const IAnimal&, const IAnimal&);
+using PLAY_MAP = std::map<std::pair<std::type_index, std::type_index>, FPTR>;
+int play(const PLAY_MAP& play_map, const IAnimal& first,
+         const IAnimal& second) {
+    return play_map.find({typeid(first), typeid(second)})->second(first,
+                                                                  second);
+}
+} // namespace double_dispatch2
+
+template <int Value>
+int value(const IAnimal&, const IAnimal&) {
+    return Value;
+}
+template <typename First, typename Second, int Value>
+int pair_value(const First&, const Second&) {
+    return Value;
+}
+// registers pair_value as a compile-time function
+template <typename First, typename Second, int Value>
+void add_pair(Multimethod<int(const IAnimal&, const IAnimal&)>& method) {
+    method.add<int (*)(const First&, const Second&),
+               &pair_value<First, Second, Value>>();
+}
+
+int main(int argc, char** argv) {
+    Hierarchy animals;
+    animals.add<IAnimal>();
+    animals.add<Cat, IAnimal>();
+    animals.add<Dog, IAnimal>();
+    animals.add<Bird, IAnimal>();
+    animals.add<Kitten, Cat>();
+
+    Multimethod<void(const IAnimal&, const IAnimal&)> play{animals};
+    play.add(any_any);
+    play.add(cat_dog);
+    play.add(dog_cat);
+    play.add(cat_bird);
+    play.build();
+
+    std::unique_ptr<IAnimal> upCat{std::make_unique<Cat>()};
+    std::unique_ptr<IAnimal> upDog{std::make_unique<Dog>()};
+    std::unique_ptr<IAnimal> upBird{std::make_unique<Bird>()};
+    std::unique_ptr<IAnimal> upKitten{std::make_unique<Kitten>()};
+
+    play(*upCat, *upDog);
+    play(*upDog, *upCat);
+    play(*upCat, *upBird);
+    play(*upBird, *upDog);   // falls back to (IAnimal, IAnimal)
+    play(*upKitten, *upDog); // inherited from (Cat, Dog)
+    std::cout << "Table size: " << play.table_size() << " entries\n";
+
+    // adding a type or an interaction touches no existing code
+    play.add(kitten_dog);
+    play.add(any_cat);
+    play.add(cat_any);
+    play.build();
+    play(*upKitten, *upDog); // (Kitten, Dog) is more specific
+    play(*upBird, *upCat);
+    try {
+        // (IAnimal, Cat) and (Cat, IAnimal) match equally well
+        play(*upKitten, *upCat);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << '\n';
+    }
+    std::cout << "Table size: " << play.table_size() << " entries\n";
+
+    Multimethod<void(const IAnimal&, const IAnimal&, const IAnimal&)> meet{
+        animals};
+    meet.add(trio);
+    meet.add(trio_birds);
+    meet.build();
+    meet(*upBird, *upBird, *upBird);
+    meet(*upBird, *upCat, *upBird);
+
+    // a class registered later is dispatched on once the method is rebuilt
+    animals.add<Puppy, Dog>();
+    std::unique_ptr<IAnimal> upPuppy{std::make_unique<Puppy>()};
+    try {
+        play(*upPuppy, *upCat);
+    } catch (const std::logic_error& e) {
+        std::cerr << e.what() << '\n';
+    }
+    try {
+        animals.add<Puppy, Dog>();
+    } catch (const std::logic_error& e) {
+        std::cerr << e.what() << '\n';
+    }
+    play.build();
+    play(*upPuppy, *upCat); // inherited from (Dog, Cat)
+    std::cout << '\n';
+
+    // benchmark: random pairs of cats, dogs and birds
+    const std::size_t N = 1024;
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> kind(0, 2);
+
+    std::vector<std::unique_ptr<double_dispatch1::IAnimal>> dd1_animals;
+    std::vector<std::unique_ptr<IAnimal>> mm_animals;
+    for (std::size_t i = 0; i < N; ++i) {
+        switch (kind(gen)) {
+            case 0:
+                dd1_animals.push_back(
+                    std::make_unique<double_dispatch1::Cat>());
+                mm_animals.push_back(std::make_unique<Cat>());
+                break;
+            case 1:
+                dd1_animals.push_back(
+                    std::make_unique<double_dispatch1::Dog>());
+                mm_animals.push_back(std::make_unique<Dog>());
+                break;
+            default:
+                dd1_animals.push_back(
+                    std::make_unique<double_dispatch1::Bird>());
+                mm_animals.push_back(std::make_unique<Bird>());
+        }
+    }
+
+    double_dispatch2::PLAY_MAP play_map;
+    const std::type_index types[] = {typeid(Cat), typeid(Dog), typeid(Bird)};
+    double_dispatch2::FPTR values[] = {
+        value<1>, value<2>, value<3>, value<4>, value<5>,
+        value<6>, value<7>, value<8>, value<9>};
+    for (std::size_t a = 0; a < 3; ++a)
+        for (std::size_t b = 0; b < 3; ++b)
+            play_map[{types[a], types[b]}] = values[a * 3 + b];
+
+    // the same values, one function per pair and a fallback
+    Multimethod<int(const IAnimal&, const IAnimal&)> score{animals};
+    score.add(value<0>);
+    score.add(pair_value<Cat, Cat, 1>);
+    score.add(pair_value<Cat, Dog, 2>);
+    score.add(pair_value<Cat, Bird, 3>);
+    score.add(pair_value<Dog, Cat, 4>);
+    score.add(pair_value<Dog, Dog, 5>);
+    score.add(pair_value<Dog, Bird, 6>);
+    score.add(pair_value<Bird, Cat, 7>);
+    score.add(pair_value<Bird, Dog, 8>);
+    score.add(pair_value<Bird, Bird, 9>);
+    score.build();
+    Multimethod<int(const IAnimal&, const IAnimal&)> score_direct{animals};
+    score_direct.add<decltype(&value<0>), &value<0>>();
+    add_pair<Cat, Cat, 1>(score_direct);
+    add_pair<Cat, Dog, 2>(score_direct);
+    add_pair<Cat, Bird, 3>(score_direct);
+    add_pair<Dog, Cat, 4>(score_direct);
+    add_pair<Dog, Dog, 5>(score_direct);
+    add_pair<Dog, Bird, 6>(score_direct);
+    add_pair<Bird, Cat, 7>(score_direct);
+    add_pair<Bird, Dog, 8>(score_direct);
+    add_pair<Bird, Bird, 9>(score_direct);
+    score_direct.build();
+
+    // ops are calls
+    bench::Suite suite{"multimethods", argc, argv};
+    suite.add("double_dispatch1/virtual", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += dd1_animals[i % N]->play(*dd1_animals[(i * 7 + 1) % N]);
+        bench::do_not_optimize(sum);
+    });
+    suite.add("double_dispatch2/map", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += double_dispatch2::play(play_map, *mm_animals[i % N],
+                                          *mm_animals[(i * 7 + 1) % N]);
+        bench::do_not_optimize(sum);
+    });
+    suite.add("multimethod/table", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += score(*mm_animals[i % N], *mm_animals[(i * 7 + 1) % N]);
+        bench::do_not_optimize(sum);
+    });
+    suite.add("multimethod/table_direct", [&](std::size_t n) {
+        int sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            sum += score_direct(*mm_animals[i % N],
+                                *mm_animals[(i * 7 + 1) % N]);
+        bench::do_not_optimize(sum);
+    });
+    return suite.run();
+}
@@ -0,0 +1,437 @@
+// Observer design pattern, typed event bus
+// events carry their payload and are written into a preallocated ring
+// buffer (Disruptor style: producers claim sequence numbers, the consumer
+// follows a sequence barrier); the consumer delivers every event by
+// reference to the observers subscribed to its type and topic, no heap
+// allocation happens per event
+// single- and multi-producer rings are separate instantiations
+
+// compile with g++ -std=c++14 -O2 -pthread observer_event_bus.cpp
+// -oobserver_event_bus
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "bench/bench.h"
+
+using Topic = std::uint32_t;
+
+// observer of one event type
+template <typename Event>
+struct IEvent_Observer {
+    virtual void on_event(Topic topic, const Event& event) = 0;
+    virtual ~IEvent_Observer() = default;
+};
+
+enum class Producers { SINGLE, MULTI };
+
+// spins briefly, then yields to the other threads
+inline void backoff(unsigned& spins) {
+    if (++spins > 64)
+        std::this_thread::yield();
+}
+
+template <Producers Mode, typename... Events>
+class Event_Bus {
+    static constexpr std::size_t n_types = sizeof...(Events);
+    static_assert(n_types > 0, "Event_Bus: no event types");
+
+    template <typename E, typename... Es>
+    struct Index_Of;
+    template <typename E, typename... Es>
+    struct Index_Of<E, E, Es...> : std::integral_constant<std::size_t, 0> {};
+    template <typename E, typename F, typename... Es>
+    struct Index_Of<E, F, Es...>
+        : std::integral_constant<std::size_t, 1 + Index_Of<E, Es...>::value> {
+    };
+
+    // events are copied into the ring and never destroyed
+    template <typename... Es>
+    struct All_Trivial : std::true_type {};
+    template <typename E, typename... Es>
+    struct All_Trivial<E, Es...>
+        : std::integral_constant<bool, std::is_trivially_copyable<E>::value &&
+                                           All_Trivial<Es...>::value> {};
+    static_assert(All_Trivial<Events...>::value,
+                  "Event_Bus: events must be trivially copyable");
+
+    struct Slot {
+        std::atomic<std::int64_t> published{-1}; // multi-producer only
+        Topic topic = 0;
+        std::size_t type = 0;
+        typename std::aligned_union<0, Events...>::type storage;
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    const std::int64_t _capacity;
+    const Topic _n_topics;
+
+    // producer side
+    alignas(64) std::atomic<std::int64_t> _claimed{-1}; // last claimed
+    alignas(64) std::atomic<std::int64_t> _cursor{-1};  // last published
+    std::int64_t _cached_consumed = -1; // single producer only
+    // consumer side
+    alignas(64) std::atomic<std::int64_t> _consumed{-1}; // last delivered
+
+    // observers per event type, indexed by topic; the extra last entry
+    // holds the observers of every topic
+    std::tuple<std::vector<std::vector<IEvent_Observer<Events>*>>...>
+        _subscribers;
+
+    template <typename E>
+    void deliver(const Slot& slot) const {
+        const E& event = *reinterpret_cast<const E*>(&slot.storage);
+        auto& by_topic = std::get<Index_Of<E, Events...>::value>(_subscribers);
+        for (auto* observer : by_topic[slot.topic])
+            observer->on_event(slot.topic, event);
+        for (auto* observer : by_topic[_n_topics])
+            observer->on_event(slot.topic, event);
+    }
+    using Deliver = void (Event_Bus::*)(const Slot&) const;
+    const Deliver _deliver[n_types] = {&Event_Bus::deliver<Events>...};
+
+    std::int64_t claim() {
+        if (Mode == Producers::SINGLE) {
+            std::int64_t seq = _claimed.load(std::memory_order_relaxed) + 1;
+            _claimed.store(seq, std::memory_order_relaxed);
+            // the slot must have been delivered one lap ago
+            unsigned spins = 0;
+            while (seq - _capacity > _cached_consumed) {
+                _cached_consumed = _consumed.load(std::memory_order_acquire);
+                if (seq - _capacity > _cached_consumed)
+                    backoff(spins);
+            }
+            return seq;
+        }
+        std::int64_t seq = _claimed.fetch_add(1) + 1;
+        unsigned spins = 0;
+        while (seq - _capacity > _consumed.load(std::memory_order_acquire))
+            backoff(spins);
+        return seq;
+    }
+
+    void commit(std::int64_t seq) {
+        if (Mode == Producers::SINGLE)
+            _cursor.store(seq, std::memory_order_release);
+        else
+            _slots[seq & (_capacity - 1)].published.store(
+                seq, std::memory_order_release);
+    }
+
+    // sequence barrier: last sequence that can be delivered
+    std::int64_t available(std::int64_t next) const {
+        if (Mode == Producers::SINGLE)
+            return _cursor.load(std::memory_order_acquire);
+        // producers may commit out of order, stop at the first gap
+        std::int64_t seq = next;
+        while (_slots[seq & (_capacity - 1)].published.load(
+                   std::memory_order_acquire) == seq)
+            ++seq;
+        return seq - 1;
+    }
+
+  public:
+    // capacity is rounded up to a power of two, topics are 0..n_topics-1
+    Event_Bus(std::size_t capacity, Topic n_topics)
+        : _slots{nullptr},
+          _capacity{[capacity] {
+              std::int64_t result = 1;
+              while (result < static_cast<std::int64_t>(capacity))
+                  result <<= 1;
+              return result;
+          }()},
+          _n_topics{n_topics},
+          _subscribers{std::vector<std::vector<IEvent_Observer<Events>*>>(
+              n_topics + 1)...} {
+        _slots.reset(new Slot[_capacity]);
+    }
+    Event_Bus(const Event_Bus&) = delete;
+    Event_Bus& operator=(const Event_Bus&) = delete;
+
+    // subscriptions are set up before events flow
+    template <typename E>
+    void subscribe(Topic topic, IEvent_Observer<E>& observer) {
+        if (topic >= _n_topics)
+            throw std::out_of_range("Event_Bus: no such topic");
+        std::get<Index_Of<E, Events...>::value>(_subscribers)[topic]
+            .push_back(&observer);
+    }
+    template <typename E>
+    void subscribe_all(IEvent_Observer<E>& observer) {
+        std::get<Index_Of<E, Events...>::value>(_subscribers)[_n_topics]
+            .push_back(&observer);
+    }
+
+    // blocks while the ring is full
+    template <typename E>
+    void publish(Topic topic, const E& event) {
+        if (topic >= _n_topics)
+            throw std::out_of_range("Event_Bus: no such topic");
+        std::int64_t seq = claim();
+        Slot& slot = _slots[seq & (_capacity - 1)];
+        slot.topic = topic;
+        slot.type = Index_Of<E, Events...>::value;
+        new (&slot.storage) E(event);
+        commit(seq);
+    }
+
+    // consumer: delivers the events published so far, returns their number
+    // must be called from one thread at a time
+    std::size_t poll() {
+        std::int64_t next = _consumed.load(std::memory_order_relaxed) + 1;
+        std::int64_t last = available(next);
+        for (std::int64_t seq = next; seq <= last; ++seq) {
+            const Slot& slot = _slots[seq & (_capacity - 1)];
+            (this->*_deliver[slot.type])(slot);
+        }
+        if (last >= next)
+            _consumed.store(last, std::memory_order_release);
+        return static_cast<std::size_t>(last - next + 1);
+    }
+
+    // consumer loop, returns once stop is set and the ring is drained
+    void run(const std::atomic<bool>& stop) {
+        unsigned spins = 0;
+        for (;;) {
+            if (poll()) {
+                spins = 0;
+                continue;
+            }
+            if (stop.load(std::memory_order_acquire) && !poll())
+                return;
+            backoff(spins);
+        }
+    }
+};
+
+// events
+struct Price_Tick {
+    std::int64_t sent_ns;
+    double price;
+};
+struct Order_Fill {
+    std::int64_t sent_ns;
+    std::uint32_t quantity;
+};
+
+enum Instrument : Topic { EUR_USD, USD_JPY, GOLD, N_INSTRUMENTS };
+
+std::int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+class Price_Printer : public IEvent_Observer<Price_Tick> {
+    const char* _name;
+
+  public:
+    explicit Price_Printer(const char* name) : _name{name} {}
+    void on_event(Topic topic, const Price_Tick& tick) override {
+        std::cout << '\t' << _name << ": instrument " << topic << " at "
+                  << tick.price << '\n';
+    }
+};
+
+class Fill_Printer : public IEvent_Observer<Order_Fill> {
+  public:
+    void on_event(Topic topic, const Order_Fill& fill) override {
+        std::cout << "\tFill: " << fill.quantity << " of instrument " << topic
+                  << '\n';
+    }
+};
+
+// records the publish-to-delivery latency of every event it sees
+class Latency_Recorder : public IEvent_Observer<Price_Tick> {
+  public:
+    std::vector<double> latencies_ns{};
+    explicit Latency_Recorder(std::size_t n) { latencies_ns.reserve(n); }
+    void on_event(Topic, const Price_Tick& tick) override {
+        if (latencies_ns.size() < latencies_ns.capacity())
+            latencies_ns.push_back(
+                static_cast<double>(now_ns() - tick.sent_ns));
+    }
+};
+
+// baseline in the spirit of observer.cpp: one heap-allocated event per
+// publish behind a mutex, every observer gets every event and filters
+struct IEvent {
+    Topic topic = 0;
+    virtual ~IEvent() = default;
+};
+struct Heap_Price_Tick : IEvent {
+    Price_Tick tick{};
+};
+struct IObserver {
+    virtual void notify(const IEvent& event) = 0;
+    virtual ~IObserver() = default;
+};
+class Locked_Queue_Bus {
+    std::mutex _mutex{};
+    std::deque<std::unique_ptr<IEvent>> _queue{};
+    std::vector<IObserver*> _observers{};
+
+  public:
+    void subscribe(IObserver& observer) { _observers.push_back(&observer); }
+    void publish(Topic topic, const Price_Tick& tick) {
+        auto event = std::make_unique<Heap_Price_Tick>();
+        event->topic = topic;
+        event->tick = tick;
+        std::lock_guard<std::mutex> lock{_mutex};
+        _queue.push_back(std::move(event));
+    }
+    std::size_t poll() {
+        std::deque<std::unique_ptr<IEvent>> batch;
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            batch.swap(_queue);
+        }
+        for (auto&& event : batch)
+            for (auto* observer : _observers)
+                observer->notify(*event);
+        return batch.size();
+    }
+    void run(const std::atomic<bool>& stop) {
+        unsigned spins = 0;
+        for (;;) {
+            if (poll()) {
+                spins = 0;
+                continue;
+            }
+            if (stop.load(std::memory_order_acquire) && !poll())
+                return;
+            backoff(spins);
+        }
+    }
+};
+class Filtering_Recorder : public IObserver {
+    Topic _topic;
+    Latency_Recorder& _recorder;
+
+  public:
+    Filtering_Recorder(Topic topic, Latency_Recorder& recorder)
+        : _topic{topic}, _recorder{recorder} {}
+    void notify(const IEvent& event) override {
+        if (event.topic != _topic)
+            return;
+        if (auto* price = dynamic_cast<const Heap_Price_Tick*>(&event))
+            _recorder.on_event(event.topic, price->tick);
+    }
+};
+
+// n_producers threads publish events round-robin over the instruments, the
+// calling thread consumes; prints throughput and latency percentiles
+template <typename Bus, typename Subscribe>
+void measure(const char* name, Bus& bus, Subscribe subscribe,
+             std::size_t n_producers, std::size_t n_events) {
+    std::vector<std::unique_ptr<Latency_Recorder>> recorders;
+    for (Topic topic = 0; topic < N_INSTRUMENTS; ++topic) {
+        recorders.push_back(std::make_unique<Latency_Recorder>(n_events));
+        subscribe(topic, *recorders.back());
+    }
+
+    std::atomic<bool> stop{false};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < n_producers; ++p)
+        producers.emplace_back([&bus, p, n_producers, n_events] {
+            for (std::size_t i = p; i < n_events; i += n_producers)
+                bus.publish(static_cast<Topic>(i % N_INSTRUMENTS),
+                            Price_Tick{now_ns(), static_cast<double>(i)});
+        });
+    std::thread closer{[&] {
+        for (auto&& producer : producers)
+            producer.join();
+        stop.store(true, std::memory_order_release);
+    }};
+    bus.run(stop);
+    closer.join();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    std::vector<double> latencies;
+    for (auto&& recorder : recorders)
+        latencies.insert(latencies.end(), recorder->latencies_ns.begin(),
+                         recorder->latencies_ns.end());
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << ": " << n_producers << " producer(s), "
+              << latencies.size() / seconds / 1e6 << " M events/s, latency"
+              << " p50 " << bench::percentile(latencies, 50) / 1e3
+              << " us, p99 " << bench::percentile(latencies, 99) / 1e3
+              << " us, p99.9 " << bench::percentile(latencies, 99.9) / 1e3
+              << " us\n";
+}
+
+int main() {
+    // one subject, observers pick their topic and event type
+    Event_Bus<Producers::SINGLE, Price_Tick, Order_Fill> bus{64,
+                                                             N_INSTRUMENTS};
+    Price_Printer eur_desk{"EUR desk"}, audit{"Audit"};
+    Fill_Printer fills;
+    bus.subscribe<Price_Tick>(EUR_USD, eur_desk);
+    bus.subscribe_all<Price_Tick>(audit);
+    bus.subscribe_all<Order_Fill>(fills);
+
+    std::cout << "Publishing 3 ticks and a fill...\n";
+    bus.publish(EUR_USD, Price_Tick{now_ns(), 1.08});
+    bus.publish(USD_JPY, Price_Tick{now_ns(), 151.2});
+    bus.publish(GOLD, Order_Fill{now_ns(), 100});
+    bus.publish(EUR_USD, Price_Tick{now_ns(), 1.09});
+    bus.poll();
+    std::cout << '\n';
+
+    const std::size_t n_events = 1 << 20, capacity = 1 << 14;
+    {
+        Locked_Queue_Bus locked;
+        std::vector<std::unique_ptr<Filtering_Recorder>> filters;
+        measure("Locked_Queue_Bus     ", locked,
+                [&](Topic topic, Latency_Recorder& recorder) {
+                    filters.push_back(
+                        std::make_unique<Filtering_Recorder>(topic, recorder));
+                    locked.subscribe(*filters.back());
+                },
+                1, n_events);
+    }
+    {
+        Event_Bus<Producers::SINGLE, Price_Tick, Order_Fill> ring{
+            capacity, N_INSTRUMENTS};
+        measure("Event_Bus<SINGLE>    ", ring,
+                [&](Topic topic, Latency_Recorder& recorder) {
+                    ring.subscribe<Price_Tick>(topic, recorder);
+                },
+                1, n_events);
+    }
+    for (std::size_t n_producers : {1, 2, 4}) {
+        Event_Bus<Producers::MULTI, Price_Tick, Order_Fill> ring{
+            capacity, N_INSTRUMENTS};
+        measure("Event_Bus<MULTI>     ", ring,
+                [&](Topic topic, Latency_Recorder& recorder) {
+                    ring.subscribe<Price_Tick>(topic, recorder);
+                },
+                n_producers, n_events);
+    }
+    for (std::size_t n_producers : {2, 4}) {
+        Locked_Queue_Bus locked;
+        std::vector<std::unique_ptr<Filtering_Recorder>> filters;
+        measure("Locked_Queue_Bus     ", locked,
+                [&](Topic topic, Latency_Recorder& recorder) {
+                    filters.push_back(
+                        std::make_unique<Filtering_Recorder>(topic, recorder));
+                    locked.subscribe(*filters.back());
+                },
+                n_producers, n_events);
+    }
+}
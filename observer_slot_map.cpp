@@ -0,0 +1,316 @@
+// Observer design pattern, slot map storage
+// the subject keeps its observers by value in one dense array; observers are
+// referred to by generational handles, registering and unregistering are
+// O(1) (free list, swap-and-pop) and notification walks contiguous memory
+// a Subject<T> holds one concrete observer type; observers of different
+// types go through the IObserver interface of observer.cpp, as
+// Subject<Polymorphic_Observer>, which keeps the handles and the dense walk
+// but pays one virtual call and one indirection per notification
+
+// compile with g++ -std=c++14 -O2 observer_slot_map.cpp -oobserver_slot_map
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "bench/bench.h"
+
+// refers to a slot map element; stays invalid once the element is erased,
+// even if its slot is reused
+struct Handle {
+    std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t generation = 0;
+};
+
+template <typename T>
+class Slot_Map {
+    static constexpr std::uint32_t npos =
+        std::numeric_limits<std::uint32_t>::max();
+
+    // position of the element in _values, or the next free slot
+    struct Slot {
+        std::uint32_t dense_or_next;
+        std::uint32_t generation;
+    };
+
+    std::vector<T> _values{};
+    std::vector<std::uint32_t> _owners{}; // slot of each element of _values
+    std::vector<Slot> _slots{};
+    std::uint32_t _free = npos; // head of the free slot list
+
+    bool valid(Handle handle) const {
+        return handle.index < _slots.size() &&
+               _slots[handle.index].generation == handle.generation;
+    }
+
+  public:
+    void reserve(std::size_t n) {
+        _values.reserve(n);
+        _owners.reserve(n);
+        _slots.reserve(n);
+    }
+
+    template <typename... Args>
+    Handle emplace(Args&&... args) {
+        if (_values.size() == npos)
+            throw std::length_error("Slot_Map: full");
+        std::uint32_t index = _free;
+        if (index == npos) {
+            index = static_cast<std::uint32_t>(_slots.size());
+            _slots.push_back({0, 0});
+        } else {
+            _free = _slots[index].dense_or_next;
+        }
+        _values.emplace_back(std::forward<Args>(args)...);
+        _owners.push_back(index);
+        _slots[index].dense_or_next =
+            static_cast<std::uint32_t>(_values.size() - 1);
+        return {index, _slots[index].generation};
+    }
+
+    // moves the last element into the hole, returns false for stale handles
+    bool erase(Handle handle) {
+        if (!valid(handle))
+            return false;
+        Slot& slot = _slots[handle.index];
+        std::uint32_t dense = slot.dense_or_next;
+        if (dense + 1 != _values.size()) {
+            _values[dense] = std::move(_values.back());
+            _owners[dense] = _owners.back();
+            _slots[_owners[dense]].dense_or_next = dense;
+        }
+        _values.pop_back();
+        _owners.pop_back();
+        ++slot.generation;
+        slot.dense_or_next = _free;
+        _free = handle.index;
+        return true;
+    }
+
+    T* find(Handle handle) {
+        return valid(handle) ? &_values[_slots[handle.index].dense_or_next]
+                             : nullptr;
+    }
+
+    std::size_t size() const { return _values.size(); }
+    // dense iteration, in no particular order
+    typename std::vector<T>::iterator begin() { return _values.begin(); }
+    typename std::vector<T>::iterator end() { return _values.end(); }
+};
+
+// concrete observers
+class Observer {
+    std::size_t _ID;
+
+  public:
+    explicit Observer(std::size_t ID) : _ID{ID} {}
+    void notify() const { std::cout << "\tObserver " << _ID << " notified!\n"; }
+    std::size_t ID() const { return _ID; }
+};
+
+class Counting_Observer {
+    std::size_t _ID;
+    std::size_t _notifications = 0;
+
+  public:
+    explicit Counting_Observer(std::size_t ID) : _ID{ID} {}
+    void notify() { ++_notifications; }
+    std::size_t ID() const { return _ID; }
+    std::size_t notifications() const { return _notifications; }
+};
+
+// observer interface of observer.cpp
+struct IObserver {
+    virtual void notify() const = 0;
+    virtual ~IObserver() = default;
+};
+
+// any of the concrete observers above, as an IObserver
+template <typename T>
+class Observer_Adapter : public IObserver {
+    mutable T _observer;
+
+  public:
+    template <typename... Args>
+    explicit Observer_Adapter(Args&&... args)
+        : _observer(std::forward<Args>(args)...) {}
+    void notify() const override { _observer.notify(); }
+    const T& get() const { return _observer; }
+};
+
+// slot map element forwarding to an IObserver of any type
+class Polymorphic_Observer {
+    std::shared_ptr<IObserver> _observer;
+
+  public:
+    explicit Polymorphic_Observer(std::shared_ptr<IObserver> observer)
+        : _observer{std::move(observer)} {}
+    void notify() const { _observer->notify(); }
+};
+
+// subject owning its observers, which are kept by value
+template <typename Observer_Type>
+class Subject {
+    Slot_Map<Observer_Type> _observers{};
+
+  public:
+    void reserve(std::size_t n) { _observers.reserve(n); }
+    template <typename... Args>
+    Handle registerObserver(Args&&... args) {
+        return _observers.emplace(std::forward<Args>(args)...);
+    }
+    bool unregisterObserver(Handle handle) {
+        return _observers.erase(handle);
+    }
+    Observer_Type* observer(Handle handle) { return _observers.find(handle); }
+    std::size_t size() const { return _observers.size(); }
+    void notifyObservers() {
+        for (auto& observer : _observers)
+            observer.notify();
+    }
+};
+
+// the std::map based subject of observer.cpp, without the interfaces
+class Map_Subject {
+    std::map<std::size_t, std::shared_ptr<Counting_Observer>> _observers{};
+
+  public:
+    void registerObserver(std::shared_ptr<Counting_Observer> spo) {
+        _observers[spo->ID()] = spo;
+    }
+    void unregisterObserver(const std::shared_ptr<Counting_Observer>& spo) {
+        _observers.erase(spo->ID());
+    }
+    void notifyObservers() const {
+        for (auto& elem : _observers)
+            elem.second->notify();
+    }
+};
+
+double elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// register n observers, notify them all, unregister them in random order;
+// small sizes are repeated, prints ns per observer for every phase
+void scale(std::size_t n) {
+    using clock = std::chrono::steady_clock;
+    std::mt19937 gen{static_cast<std::mt19937::result_type>(n)};
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), gen);
+    const std::size_t rounds = std::max<std::size_t>(1, (1 << 20) / n);
+
+    // the map subject shares ownership, as in observer.cpp
+    std::vector<std::shared_ptr<Counting_Observer>> shared;
+    shared.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        shared.push_back(std::make_shared<Counting_Observer>(i));
+    double map_add = 0, map_notify = 0, map_remove = 0;
+    for (std::size_t r = 0; r < rounds; ++r) {
+        Map_Subject subject;
+        auto start = clock::now();
+        for (auto&& spo : shared)
+            subject.registerObserver(spo);
+        map_add += elapsed_ns(start);
+        start = clock::now();
+        subject.notifyObservers();
+        map_notify += elapsed_ns(start);
+        start = clock::now();
+        for (auto i : order)
+            subject.unregisterObserver(shared[i]);
+        map_remove += elapsed_ns(start);
+    }
+    bench::do_not_optimize(shared.front()->notifications());
+    shared.clear();
+
+    double slot_add = 0, slot_notify = 0, slot_remove = 0;
+    std::vector<Handle> handles(n);
+    for (std::size_t r = 0; r < rounds; ++r) {
+        Subject<Counting_Observer> subject;
+        auto start = clock::now();
+        for (std::size_t i = 0; i < n; ++i)
+            handles[i] = subject.registerObserver(i);
+        slot_add += elapsed_ns(start);
+        start = clock::now();
+        subject.notifyObservers();
+        slot_notify += elapsed_ns(start);
+        bench::do_not_optimize(subject.observer(handles[0])->notifications());
+        start = clock::now();
+        for (auto i : order)
+            subject.unregisterObserver(handles[i]);
+        slot_remove += elapsed_ns(start);
+    }
+
+    const double ops = static_cast<double>(n * rounds);
+    std::cout << std::setw(10) << n << std::fixed << std::setprecision(2)
+              << std::setw(12) << map_add / ops << std::setw(12)
+              << slot_add / ops << std::setw(12) << map_notify / ops
+              << std::setw(12) << slot_notify / ops << std::setw(12)
+              << map_remove / ops << std::setw(12) << slot_remove / ops
+              << '\n';
+}
+
+int main(int argc, char** argv) {
+    // 1 subject
+    Subject<Observer> subject;
+
+    // N observers, owned by the subject
+    std::size_t N = 4;
+    std::vector<Handle> handles;
+    std::cout << "Registering all " << N << " Observers...\n";
+    for (std::size_t i = 0; i < N; ++i)
+        handles.push_back(subject.registerObserver(i));
+
+    // notify
+    std::cout << "Notifying all " << N << " Observers...\n";
+    subject.notifyObservers();
+
+    // un-register Observers 1 and 2
+    std::cout << "Un-registering Observer 1 and Observer 2...\n";
+    subject.unregisterObserver(handles[1]);
+    subject.unregisterObserver(handles[2]);
+
+    // notify
+    std::cout << "Notifying remaining Observers:\n";
+    subject.notifyObservers();
+
+    // handles of removed observers stay invalid, even after slot reuse
+    subject.registerObserver(4);
+    std::cout << "Observer 1 still registered: " << std::boolalpha
+              << (subject.observer(handles[1]) != nullptr) << "\n\n";
+
+    // observers of different types, through IObserver
+    Subject<Polymorphic_Observer> mixed;
+    auto counting = std::make_shared<Observer_Adapter<Counting_Observer>>(6);
+    mixed.registerObserver(std::make_shared<Observer_Adapter<Observer>>(5));
+    mixed.registerObserver(counting);
+    std::cout << "Notifying observers of two types:\n";
+    mixed.notifyObservers();
+    std::cout << "\tObserver 6 counted " << counting->get().notifications()
+              << " notification(s)\n\n";
+
+    // scaling, up to the optional command line argument (default 10M)
+    std::size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                 : 10000000;
+    std::cout << "ns per observer: register, notify, unregister (random)\n"
+              << std::setw(10) << "observers" << std::setw(12) << "map add"
+              << std::setw(12) << "slot add" << std::setw(12) << "map notify"
+              << std::setw(12) << "slot notify" << std::setw(12)
+              << "map remove" << std::setw(12) << "slot remove" << '\n';
+    for (std::size_t n = 1; n <= max_n; n *= 10)
+        scale(n);
+}
@@ -0,0 +1,51 @@
+// Classic pimpl (Book) versus fast pimpl (FastBook): construction, copy and
+// traversal of a large number of records
+
+// compile with g++ -std=c++14 -O2 book.cpp book_fast.cpp bench.cpp -obench
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "book.h"
+#include "book_fast.h"
+
+template <typename F>
+double time_ms(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+template <typename T>
+void bench(const char* name, std::size_t n) {
+    std::vector<T> books;
+    books.reserve(n);
+    double construct = time_ms([&] {
+        for (std::size_t i = 0; i < n; ++i)
+            books.emplace_back("Title", static_cast<double>(i % 100));
+    });
+
+    std::vector<T> copies;
+    double copy = time_ms([&] { copies = books; });
+
+    double sum = 0;
+    double traverse = time_ms([&] {
+        for (auto&& book : copies)
+            sum += book.price() + book.title().size();
+    });
+
+    std::cout << name << ": construct " << construct << " ms, copy " << copy
+              << " ms, traverse " << traverse << " ms (" << sum << ")\n";
+}
+
+int main() {
+    const std::size_t n = 2000000;
+    std::cout << n << " records, sizeof(Book) = " << sizeof(Book)
+              << ", sizeof(FastBook) = " << sizeof(FastBook) << '\n';
+    bench<Book>("Book    ", n);
+    bench<FastBook>("FastBook", n);
+}
@@ -17,10 +17,29 @@ struct Book::BookImpl {
 // BEGIN Book implementation
 Book::Book(const std::string& title, double price)
     : upBookImpl{std::make_unique<BookImpl>(title, price)} {}
+// a moved-from Book has no implementation, and neither have its copies
+Book::Book(const Book& other)
+    : upBookImpl{other.upBookImpl
+                     ? std::make_unique<BookImpl>(*other.upBookImpl)
+                     : nullptr} {}
+Book::Book(Book&& other) noexcept = default;
+Book& Book::operator=(const Book& other) {
+    if (!other.upBookImpl)
+        upBookImpl.reset();
+    else if (upBookImpl) // may have been moved from
+        *upBookImpl = *other.upBookImpl;
+    else
+        upBookImpl = std::make_unique<BookImpl>(*other.upBookImpl);
+    return *this;
+}
+Book& Book::operator=(Book&& other) noexcept = default;
 Book::~Book() = default; // need the destructor here for unique_ptr
 
 void Book::print() {
     std::cout << "Title: " << upBookImpl->title << '\n';
     std::cout << "Price: " << upBookImpl->price << '\n';
 }
+
+const std::string& Book::title() const { return upBookImpl->title; }
+double Book::price() const { return upBookImpl->price; }
 // END Book implementation
@@ -10,12 +10,18 @@ class Book {
   public:
     // interface
     Book(const std::string& title, double price);
+    Book(const Book& other);
+    Book(Book&& other) noexcept;
+    Book& operator=(const Book& other);
+    Book& operator=(Book&& other) noexcept;
     ~Book(); // need to define it AFTER the definition of Book::BookImpl
     void print();
+    const std::string& title() const;
+    double price() const;
 
   private:
     struct BookImpl;
     std::unique_ptr<BookImpl> upBookImpl;
 };
 
-#endif // BOOK_H_
\ No newline at end of file
+#endif // BOOK_H_
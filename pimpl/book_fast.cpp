@@ -0,0 +1,58 @@
+// The "fast pimpl" idiom
+
+#include <iostream>
+#include <new>
+#include <utility>
+#include "book_fast.h"
+
+// BEGIN private implementation details
+struct FastBook::BookImpl {
+    BookImpl(const std::string& title, double price)
+        : title(title), price(price) {}
+
+    // can add more members without the need for clients of FastBook to
+    // recompile, as long as they fit in the storage
+    std::string title;
+    double price;
+};
+// END private implementation details
+
+// BEGIN FastBook implementation
+FastBook::BookImpl& FastBook::impl() noexcept {
+    return *reinterpret_cast<BookImpl*>(storage_);
+}
+const FastBook::BookImpl& FastBook::impl() const noexcept {
+    return *reinterpret_cast<const BookImpl*>(storage_);
+}
+
+FastBook::FastBook(const std::string& title, double price) : storage_{} {
+    static_assert(sizeof(BookImpl) <= impl_size,
+                  "FastBook::impl_size is too small for BookImpl");
+    static_assert(impl_align % alignof(BookImpl) == 0,
+                  "FastBook::impl_align is too weak for BookImpl");
+    new (storage_) BookImpl(title, price);
+}
+FastBook::FastBook(const FastBook& other) : storage_{} {
+    new (storage_) BookImpl(other.impl());
+}
+FastBook::FastBook(FastBook&& other) noexcept : storage_{} {
+    new (storage_) BookImpl(std::move(other.impl()));
+}
+FastBook& FastBook::operator=(const FastBook& other) {
+    impl() = other.impl();
+    return *this;
+}
+FastBook& FastBook::operator=(FastBook&& other) noexcept {
+    impl() = std::move(other.impl());
+    return *this;
+}
+FastBook::~FastBook() { impl().~BookImpl(); }
+
+void FastBook::print() {
+    std::cout << "Title: " << impl().title << '\n';
+    std::cout << "Price: " << impl().price << '\n';
+}
+
+const std::string& FastBook::title() const { return impl().title; }
+double FastBook::price() const { return impl().price; }
+// END FastBook implementation
@@ -0,0 +1,36 @@
+// The "fast pimpl" idiom: the implementation lives in aligned storage inside
+// the object instead of on the heap, clients still never see its definition
+
+#ifndef BOOK_FAST_H_
+#define BOOK_FAST_H_
+
+#include <cstddef>
+#include <string>
+
+class FastBook {
+  public:
+    // interface
+    FastBook(const std::string& title, double price);
+    FastBook(const FastBook& other);
+    FastBook(FastBook&& other) noexcept;
+    FastBook& operator=(const FastBook& other);
+    FastBook& operator=(FastBook&& other) noexcept;
+    ~FastBook(); // destroys the in-place BookImpl
+    void print();
+    const std::string& title() const;
+    double price() const;
+
+  private:
+    struct BookImpl;
+    // must be at least sizeof/alignof(BookImpl), checked in book_fast.cpp;
+    // changing them breaks the ABI, so leave some room for growth
+    static constexpr std::size_t impl_size = 48;
+    static constexpr std::size_t impl_align = alignof(std::max_align_t);
+
+    BookImpl& impl() noexcept;
+    const BookImpl& impl() const noexcept;
+
+    alignas(impl_align) unsigned char storage_[impl_size];
+};
+
+#endif // BOOK_FAST_H_
@@ -1,10 +1,14 @@
 // The pointer-to-implementation (PIMPL) idiom
 
-// compile with g++ -std=c++14 book.cpp main.cpp -opimpl
+// compile with g++ -std=c++14 book.cpp book_fast.cpp main.cpp -opimpl
 
 #include "book.h"
+#include "book_fast.h"
 
 int main() {
     Book book("Robinson Crusoe", 10.99);
     book.print();
+
+    FastBook fast_book("Moby Dick", 12.49);
+    fast_book.print();
 }
@@ -0,0 +1,216 @@
+// Proxy design pattern, asynchronous batching variant
+// coalesces calls to the real subject and forwards them as a single batch
+
+// compile with g++ -std=c++14 -pthread proxy_batching.cpp -oproxy_batching
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// car interface
+struct ICar {
+    virtual void drive() const = 0;
+    // forwards n drives at once, by default one call at a time
+    virtual void drive_batch(std::size_t n) const {
+        for (std::size_t i = 0; i < n; ++i)
+            drive();
+    }
+    virtual ~ICar() = default;
+};
+
+// concrete car, expensive per call but cheap per batch (think of a local
+// database or an IPC round trip)
+class Car : public ICar {
+    mutable std::atomic<std::size_t> trips_{0};
+
+  public:
+    static constexpr std::chrono::microseconds round_trip{50};
+
+    void drive() const override {
+        std::this_thread::sleep_for(round_trip);
+        ++trips_;
+    }
+    void drive_batch(std::size_t n) const override {
+        std::this_thread::sleep_for(round_trip); // one round trip per batch
+        trips_ += n;
+    }
+    std::size_t trips() const { return trips_; }
+};
+constexpr std::chrono::microseconds Car::round_trip;
+
+// achieved batch sizes
+struct Batch_Stats {
+    std::size_t calls = 0;
+    std::size_t batches = 0;
+    std::size_t max_batch = 0;
+    std::map<std::size_t, std::size_t> histogram{}; // batch size -> count
+
+    double mean_batch() const {
+        return batches ? static_cast<double>(calls) / batches : 0;
+    }
+};
+
+// proxy to a car, accumulates calls for up to max_batch items or
+// latency_budget and forwards them to the real car as a single batch
+class Batching_Car_Proxy : public ICar {
+    std::shared_ptr<const ICar> car_;
+    std::size_t max_batch_;
+    std::chrono::microseconds latency_budget_;
+
+    mutable std::mutex mutex_{};
+    mutable std::condition_variable cv_{};
+    // queued call and its arrival time
+    struct Pending {
+        std::promise<void> promise;
+        std::chrono::steady_clock::time_point arrival;
+    };
+    mutable std::vector<Pending> pending_{};
+    mutable Batch_Stats stats_{};
+    bool stop_ = false;
+    std::thread worker_;
+
+    void run() {
+        std::vector<Pending> batch;
+        batch.reserve(max_batch_);
+        std::unique_lock<std::mutex> lock{mutex_};
+        for (;;) {
+            cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+            if (pending_.empty())
+                return; // stopped and drained
+            // wait for the batch to fill up or for the budget to expire
+            auto deadline = pending_.front().arrival + latency_budget_;
+            cv_.wait_until(lock, deadline, [this] {
+                return stop_ || pending_.size() >= max_batch_;
+            });
+
+            std::size_t n = std::min(pending_.size(), max_batch_);
+            std::move(pending_.begin(), pending_.begin() + n,
+                      std::back_inserter(batch));
+            pending_.erase(pending_.begin(), pending_.begin() + n);
+            ++stats_.batches;
+            stats_.calls += n;
+            stats_.max_batch = std::max(stats_.max_batch, n);
+            ++stats_.histogram[n];
+
+            lock.unlock();
+            try {
+                car_->drive_batch(n);
+                for (auto&& elem : batch)
+                    elem.promise.set_value();
+            } catch (...) {
+                for (auto&& elem : batch)
+                    elem.promise.set_exception(std::current_exception());
+            }
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+  public:
+    Batching_Car_Proxy(std::shared_ptr<const ICar> car, std::size_t max_batch,
+                       std::chrono::microseconds latency_budget)
+        : car_{std::move(car)}, max_batch_{max_batch ? max_batch : 1},
+          latency_budget_{latency_budget}, worker_{[this] { run(); }} {}
+    Batching_Car_Proxy(const Batching_Car_Proxy&) = delete;
+    Batching_Car_Proxy& operator=(const Batching_Car_Proxy&) = delete;
+    ~Batching_Car_Proxy() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        cv_.notify_one();
+        worker_.join(); // flushes whatever is still pending
+    }
+
+    // queues a drive, the future becomes ready once its batch went through
+    std::future<void> drive_async() const {
+        std::promise<void> promise;
+        auto future = promise.get_future();
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            pending_.push_back({std::move(promise), now()});
+            // the worker waits either for the first call or for a full batch
+            wake = pending_.size() == 1 || pending_.size() >= max_batch_;
+        }
+        if (wake)
+            cv_.notify_one();
+        return future;
+    }
+
+    // synchronous call through the proxy, still batched with other callers
+    void drive() const override { drive_async().get(); }
+
+    Batch_Stats stats() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return stats_;
+    }
+
+  private:
+    static std::chrono::steady_clock::time_point now() {
+        return std::chrono::steady_clock::now();
+    }
+};
+
+int main() {
+    using namespace std::chrono;
+    const std::size_t threads = 8, calls_per_thread = 500;
+
+    auto car = std::make_shared<Car>();
+
+    // direct calls, one round trip each
+    auto start = steady_clock::now();
+    {
+        std::vector<std::thread> workers;
+        for (std::size_t t = 0; t < threads; ++t)
+            workers.emplace_back([&] {
+                for (std::size_t i = 0; i < calls_per_thread; ++i)
+                    car->drive();
+            });
+        for (auto&& worker : workers)
+            worker.join();
+    }
+    auto direct = duration_cast<milliseconds>(steady_clock::now() - start);
+    std::cout << "Direct:   " << car->trips() << " drives in "
+              << direct.count() << " ms\n";
+
+    // same load through the batching proxy
+    Batch_Stats stats;
+    start = steady_clock::now();
+    {
+        Batching_Car_Proxy proxy{car, 32, microseconds{200}};
+        std::vector<std::thread> workers;
+        for (std::size_t t = 0; t < threads; ++t)
+            workers.emplace_back([&] {
+                std::vector<std::future<void>> futures;
+                for (std::size_t i = 0; i < calls_per_thread; ++i)
+                    futures.push_back(proxy.drive_async());
+                for (auto&& future : futures)
+                    future.get();
+            });
+        for (auto&& worker : workers)
+            worker.join();
+        proxy.drive(); // synchronous calls go through the same queue
+        stats = proxy.stats();
+    }
+    auto batched = duration_cast<milliseconds>(steady_clock::now() - start);
+    std::cout << "Batched:  " << stats.calls << " drives in "
+              << batched.count() << " ms\n";
+
+    std::cout << "Batches:  " << stats.batches << ", mean size "
+              << stats.mean_batch() << ", max size " << stats.max_batch
+              << '\n';
+    for (auto&& elem : stats.histogram)
+        std::cout << "\tsize " << elem.first << ": " << elem.second << '\n';
+}
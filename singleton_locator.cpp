@@ -0,0 +1,289 @@
+// Singleton pattern, service locator
+// interfaces are resolved to implementations through one table owned by a
+// Singleton<Service_Locator>; lookups are a single atomic load and never
+// lock, providers can be swapped at run time (e.g. by tests), and call sites
+// can cache their resolution until the locator's generation changes
+
+// compile with g++ -std=c++14 -O2 singleton_locator.cpp -osingleton_locator
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "bench/bench.h"
+
+// generic Singleton, as in singletonCRTP.cpp
+template <typename T>
+class Singleton {
+  protected:
+    Singleton(const Singleton&) = delete;
+    Singleton& operator=(const Singleton&) = delete;
+    Singleton() noexcept = default;
+
+  public:
+    static T& get_instance() noexcept(std::is_nothrow_constructible<T>::value) {
+        static T instance;
+        return instance;
+    }
+};
+
+// interface -> implementation table
+// readers are wait-free (one acquire load per lookup), writers are
+// serialized by a mutex readers never touch; every write bumps the
+// generation, which invalidates the cached resolutions of call sites
+// the locator owns nothing but the instances handed over as unique_ptr, and
+// those live as long as the locator, so a reader never sees a dangling one
+class Service_Locator : public Singleton<Service_Locator> {
+    friend class Singleton<Service_Locator>;
+
+  public:
+    static constexpr std::size_t max_services = 64;
+
+  private:
+    std::atomic<void*> _services[max_services] = {};
+    std::atomic<std::uint64_t> _generation{1};
+    std::atomic<std::size_t> _next_id{0};
+    std::mutex _writer{};
+    std::vector<std::shared_ptr<void>> _owned{};
+
+    Service_Locator() = default;
+
+    // table index of the interface, assigned on first use
+    template <typename Interface>
+    std::size_t id() {
+        static const std::size_t id = _next_id.fetch_add(1);
+        if (id >= max_services)
+            throw std::length_error("Service_Locator: too many services");
+        return id;
+    }
+
+    template <typename Interface>
+    Interface* exchange(Interface* instance) {
+        void* old = _services[id<Interface>()].exchange(
+            instance, std::memory_order_acq_rel);
+        _generation.fetch_add(1, std::memory_order_release);
+        return static_cast<Interface*>(old);
+    }
+
+  public:
+    // the Singleton instance of Implementation serves Interface
+    template <typename Interface, typename Implementation>
+    void provide() {
+        static_assert(std::is_base_of<Interface, Implementation>::value,
+                      "Implementation must implement Interface");
+        provide<Interface>(Implementation::get_instance());
+    }
+    // instance must outlive its registration
+    template <typename Interface>
+    void provide(Interface& instance) {
+        std::lock_guard<std::mutex> lock{_writer};
+        exchange<Interface>(&instance);
+    }
+    // the locator keeps instance alive until it is destroyed itself
+    template <typename Interface>
+    void provide(std::unique_ptr<Interface> instance) {
+        std::lock_guard<std::mutex> lock{_writer};
+        exchange<Interface>(instance.get());
+        _owned.emplace_back(std::move(instance));
+    }
+    template <typename Interface>
+    void remove() {
+        std::lock_guard<std::mutex> lock{_writer};
+        exchange<Interface>(nullptr);
+    }
+
+    // nullptr if nobody provides Interface
+    template <typename Interface>
+    Interface* find() {
+        return static_cast<Interface*>(
+            _services[id<Interface>()].load(std::memory_order_acquire));
+    }
+    template <typename Interface>
+    Interface& get() {
+        Interface* instance = find<Interface>();
+        if (!instance)
+            throw std::out_of_range(std::string{"Service_Locator: no "} +
+                                    typeid(Interface).name());
+        return *instance;
+    }
+
+    std::uint64_t generation() const {
+        return _generation.load(std::memory_order_acquire);
+    }
+
+    // provides Interface for the lifetime of the override, then restores
+    // the previous provider (overrides must nest)
+    template <typename Interface>
+    class Override {
+        Interface* _previous;
+
+      public:
+        explicit Override(Interface& instance) {
+            Service_Locator& locator = get_instance();
+            std::lock_guard<std::mutex> lock{locator._writer};
+            _previous = locator.exchange<Interface>(&instance);
+        }
+        Override(const Override&) = delete;
+        Override& operator=(const Override&) = delete;
+        ~Override() {
+            Service_Locator& locator = get_instance();
+            std::lock_guard<std::mutex> lock{locator._writer};
+            locator.exchange<Interface>(_previous);
+        }
+    };
+
+    // resolution cached by one thread at one call site, refreshed when the
+    // generation has moved on
+    template <typename Interface>
+    class Cached {
+        Interface* _instance = nullptr;
+        std::uint64_t _generation = 0; // never a valid generation
+
+      public:
+        Interface& get() {
+            Service_Locator& locator = get_instance();
+            std::uint64_t generation = locator.generation();
+            if (generation != _generation) {
+                // the generation is read first: a write racing with the
+                // refresh leaves a newer generation behind
+                _instance = &locator.get<Interface>();
+                _generation = generation;
+            }
+            return *_instance;
+        }
+    };
+};
+
+constexpr std::size_t Service_Locator::max_services;
+
+// resolves Interface with a cache private to the call site and the thread
+#define LOCATE(Interface)                                                  \
+    ([]() -> Interface& {                                                  \
+        static thread_local Service_Locator::Cached<Interface> cache;      \
+        return cache.get();                                                \
+    }())
+
+// services
+class ILogger {
+  public:
+    virtual void log(const std::string& message) = 0;
+    virtual ~ILogger() = default;
+};
+
+class ICounter {
+  public:
+    virtual void add(std::size_t value) = 0;
+    virtual std::size_t total() const = 0;
+    virtual ~ICounter() = default;
+};
+
+// implementations, one Singleton each
+class Console_Logger : public ILogger, public Singleton<Console_Logger> {
+    friend class Singleton<Console_Logger>;
+    Console_Logger() = default;
+
+  public:
+    void log(const std::string& message) override {
+        std::cout << "\t[console] " << message << '\n';
+    }
+};
+
+class Counter : public ICounter, public Singleton<Counter> {
+    friend class Singleton<Counter>;
+    std::size_t _total = 0;
+    Counter() = default;
+
+  public:
+    void add(std::size_t value) override { _total += value; }
+    std::size_t total() const override { return _total; }
+};
+
+// test double
+class Memory_Logger : public ILogger {
+  public:
+    std::vector<std::string> messages{};
+    void log(const std::string& message) override {
+        messages.push_back(message);
+    }
+};
+
+void greet() { LOCATE(ILogger).log("Hello from the service locator"); }
+
+// the lock-based registry the locator replaces, for comparison
+class Locked_Registry {
+    std::mutex _mutex{};
+    std::unordered_map<std::type_index, void*> _services{};
+
+  public:
+    template <typename Interface>
+    void provide(Interface& instance) {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _services[typeid(Interface)] = &instance;
+    }
+    template <typename Interface>
+    Interface& get() {
+        std::lock_guard<std::mutex> lock{_mutex};
+        return *static_cast<Interface*>(_services.at(typeid(Interface)));
+    }
+};
+
+int main(int argc, char** argv) {
+    Service_Locator& locator = Service_Locator::get_instance();
+    locator.provide<ILogger, Console_Logger>();
+    locator.provide<ICounter, Counter>();
+    greet();
+
+    // a test swaps the logger, the cached call site follows
+    {
+        Memory_Logger memory;
+        Service_Locator::Override<ILogger> in_test{memory};
+        greet();
+        std::cout << "\tcaptured by the test: " << memory.messages.size()
+                  << " message(s)\n";
+    }
+    greet();
+
+    locator.remove<ICounter>();
+    try {
+        LOCATE(ICounter).add(1);
+    } catch (const std::out_of_range&) {
+        std::cout << "\tno ICounter provided\n\n";
+    }
+    locator.provide<ICounter, Counter>();
+
+    // ops are lookups followed by a call
+    bench::Suite suite{"singleton_locator", argc, argv};
+    suite.add("direct_get_instance", [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+            static_cast<ICounter&>(Counter::get_instance()).add(i);
+        bench::do_not_optimize(Counter::get_instance().total());
+    });
+    suite.add("locator_cached_call_site", [](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+            LOCATE(ICounter).add(i);
+        bench::do_not_optimize(Counter::get_instance().total());
+    });
+    suite.add("locator_find", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+            locator.find<ICounter>()->add(i);
+        bench::do_not_optimize(Counter::get_instance().total());
+    });
+    Locked_Registry registry;
+    registry.provide<ICounter>(Counter::get_instance());
+    suite.add("locked_registry", [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i)
+            registry.get<ICounter>().add(i);
+        bench::do_not_optimize(Counter::get_instance().total());
+    });
+    return suite.run();
+}
@@ -0,0 +1,421 @@
+// Template method design pattern, latency-instrumented variant
+// a reusable CRTP/NVI base times every hook invocation into lock-free
+// per-thread log-linear (HDR-style) histograms; a snapshot merges them and
+// reports p50/p99/p999 per hook
+// build with -DTEMPLATE_METHOD_LATENCY=0 and the instrumentation compiles
+// down to plain hook calls; -DTEMPLATE_METHOD_TSC=1 reads the x86 time stamp
+// counter instead of std::chrono::steady_clock
+
+// compile with g++ -std=c++14 -O2 -pthread template_method_latency.cpp
+// -otemplate_method_latency
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef TEMPLATE_METHOD_LATENCY
+#define TEMPLATE_METHOD_LATENCY 1
+#endif
+#ifndef TEMPLATE_METHOD_TSC
+#define TEMPLATE_METHOD_TSC 0
+#endif
+
+#if TEMPLATE_METHOD_TSC && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define TEMPLATE_METHOD_USE_TSC 1
+#else
+#define TEMPLATE_METHOD_USE_TSC 0
+#endif
+
+// raw timestamps and their conversion to nanoseconds
+struct Tick_Clock {
+#if TEMPLATE_METHOD_USE_TSC
+    static std::uint64_t now() { return __rdtsc(); }
+    // ticks per nanosecond, measured once against steady_clock
+    static double ticks_per_ns() {
+        static const double ratio = [] {
+            auto t0 = std::chrono::steady_clock::now();
+            auto c0 = __rdtsc();
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+            auto c1 = __rdtsc();
+            auto t1 = std::chrono::steady_clock::now();
+            return (c1 - c0) /
+                   std::chrono::duration<double, std::nano>(t1 - t0).count();
+        }();
+        return ratio;
+    }
+    static std::uint64_t to_ns(std::uint64_t ticks) {
+        return static_cast<std::uint64_t>(ticks / ticks_per_ns());
+    }
+#else
+    static std::uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+    static std::uint64_t to_ns(std::uint64_t ticks) { return ticks; }
+#endif
+};
+
+// log-linear histogram of nanosecond values: exact below 16 ns, then 16
+// sub-buckets per power of two (relative error below 6.25%)
+// single writer (the owning thread), any number of concurrent readers
+class Histogram {
+  public:
+    static constexpr std::size_t sub_buckets = 16;
+    static constexpr std::size_t buckets = 61 * sub_buckets;
+
+  private:
+    std::array<std::atomic<std::uint64_t>, buckets> counts_{};
+    std::atomic<std::uint64_t> max_{0};
+    std::atomic<std::uint64_t> sum_{0};
+
+    // relaxed load + store instead of fetch_add, there is only one writer
+    static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by,
+                      std::memory_order_relaxed);
+    }
+
+  public:
+    static std::size_t bucket_of(std::uint64_t ns) {
+        if (ns < sub_buckets)
+            return ns;
+        std::size_t magnitude = 63 - __builtin_clzll(ns); // >= 4
+        std::size_t sub = (ns >> (magnitude - 4)) & (sub_buckets - 1);
+        return (magnitude - 3) * sub_buckets + sub;
+    }
+    // middle of the value range of a bucket
+    static std::uint64_t value_of(std::size_t bucket) {
+        if (bucket < sub_buckets)
+            return bucket;
+        std::size_t magnitude = bucket / sub_buckets + 3;
+        std::uint64_t low = (sub_buckets + bucket % sub_buckets)
+                            << (magnitude - 4);
+        return low + (std::uint64_t{1} << (magnitude - 4)) / 2;
+    }
+
+    void record(std::uint64_t ns) {
+        bump(counts_[bucket_of(ns)], 1);
+        bump(sum_, ns);
+        if (ns > max_.load(std::memory_order_relaxed))
+            max_.store(ns, std::memory_order_relaxed);
+    }
+
+    // adds this histogram into the (plain) accumulators of a snapshot
+    void merge_into(std::vector<std::uint64_t>& counts, std::uint64_t& max,
+                    std::uint64_t& sum) const {
+        for (std::size_t i = 0; i < buckets; ++i)
+            counts[i] += counts_[i].load(std::memory_order_relaxed);
+        max = std::max(max, max_.load(std::memory_order_relaxed));
+        sum += sum_.load(std::memory_order_relaxed);
+    }
+};
+
+// latency statistics of one hook, merged over all threads
+struct Hook_Stats {
+    std::string name;
+    std::uint64_t count = 0;
+    double mean_ns = 0;
+    std::uint64_t p50_ns = 0, p99_ns = 0, p999_ns = 0, max_ns = 0;
+};
+
+// process-wide table of hooks and per-thread histograms
+class Latency_Registry {
+  public:
+    static constexpr std::size_t max_hooks = 64;
+
+  private:
+    // histograms of one thread, allocated by the thread on first use
+    struct Thread_Histograms {
+        std::array<std::atomic<Histogram*>, max_hooks> hooks{};
+        ~Thread_Histograms() {
+            for (auto&& hook : hooks)
+                delete hook.load();
+        }
+    };
+
+    std::mutex mutex_{};
+    std::vector<std::string> names_{};
+    // kept after their thread exits so no sample is lost, and handed to the
+    // next thread that records: there are as many as threads ever ran at
+    // once, however many come and go
+    std::vector<std::unique_ptr<Thread_Histograms>> threads_{};
+    std::vector<Thread_Histograms*> free_{};
+
+    // returns the histograms of a thread to the free list when it exits
+    class Lease {
+        Latency_Registry& registry_;
+        Thread_Histograms*& histograms_;
+        bool& exited_;
+
+      public:
+        Lease(Latency_Registry& registry, Thread_Histograms*& histograms,
+              bool& exited)
+            : registry_{registry}, histograms_{histograms}, exited_{exited} {}
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() {
+            std::lock_guard<std::mutex> lock{registry_.mutex_};
+            registry_.free_.push_back(histograms_);
+            histograms_ = nullptr;
+            exited_ = true;
+        }
+    };
+
+    // with the mutex held
+    Thread_Histograms* acquire() {
+        if (free_.empty()) {
+            threads_.push_back(std::make_unique<Thread_Histograms>());
+            return threads_.back().get();
+        }
+        Thread_Histograms* histograms = free_.back();
+        free_.pop_back();
+        return histograms;
+    }
+
+    // histograms of the calling thread, nullptr once it is exiting
+    Thread_Histograms* local() {
+        thread_local Thread_Histograms* histograms = nullptr;
+        thread_local bool exited = false;
+        if (histograms || exited)
+            return histograms;
+        std::lock_guard<std::mutex> lock{mutex_};
+        histograms = acquire();
+        thread_local Lease lease{*this, histograms, exited};
+        return histograms;
+    }
+
+    static void record(Thread_Histograms& histograms, std::size_t hook,
+                       std::uint64_t ns) {
+        Histogram* histogram =
+            histograms.hooks[hook].load(std::memory_order_acquire);
+        if (!histogram) {
+            histogram = new Histogram;
+            histograms.hooks[hook].store(histogram, std::memory_order_release);
+        }
+        histogram->record(ns);
+    }
+
+    Latency_Registry() = default;
+
+  public:
+    Latency_Registry(const Latency_Registry&) = delete;
+    Latency_Registry& operator=(const Latency_Registry&) = delete;
+
+    static Latency_Registry& get_instance() {
+        static Latency_Registry instance;
+        return instance;
+    }
+
+    std::size_t register_hook(std::string name) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (names_.size() == max_hooks)
+            throw std::length_error("Latency_Registry: too many hooks");
+        names_.push_back(std::move(name));
+        return names_.size() - 1;
+    }
+
+    // into the histogram of the calling thread for the given hook,
+    // lock-free after the first call on each thread
+    void record(std::size_t hook, std::uint64_t ns) {
+        if (Thread_Histograms* histograms = local()) {
+            record(*histograms, hook, ns);
+            return;
+        }
+        // timed by a destructor after the lease: borrow free histograms
+        std::lock_guard<std::mutex> lock{mutex_};
+        Thread_Histograms* borrowed = acquire();
+        record(*borrowed, hook, ns);
+        free_.push_back(borrowed);
+    }
+
+    std::vector<Hook_Stats> snapshot() {
+        std::lock_guard<std::mutex> lock{mutex_};
+        std::vector<Hook_Stats> result;
+        for (std::size_t hook = 0; hook < names_.size(); ++hook) {
+            std::vector<std::uint64_t> counts(Histogram::buckets, 0);
+            std::uint64_t max = 0, sum = 0;
+            for (auto&& thread : threads_)
+                if (auto* histogram = thread->hooks[hook].load(
+                        std::memory_order_acquire))
+                    histogram->merge_into(counts, max, sum);
+
+            Hook_Stats stats;
+            stats.name = names_[hook];
+            for (auto count : counts)
+                stats.count += count;
+            stats.max_ns = max;
+            stats.mean_ns = stats.count ? static_cast<double>(sum) / stats.count
+                                        : 0;
+            auto quantile = [&](double q) -> std::uint64_t {
+                auto rank = static_cast<std::uint64_t>(q * stats.count);
+                std::uint64_t seen = 0;
+                for (std::size_t i = 0; i < counts.size(); ++i)
+                    if ((seen += counts[i]) > rank)
+                        return std::min(Histogram::value_of(i), max);
+                return max;
+            };
+            stats.p50_ns = quantile(0.5);
+            stats.p99_ns = quantile(0.99);
+            stats.p999_ns = quantile(0.999);
+            result.push_back(stats);
+        }
+        return result;
+    }
+
+    void export_json(std::ostream& os) {
+        auto stats = snapshot();
+        os << "{\"hooks\": [\n";
+        for (std::size_t i = 0; i < stats.size(); ++i) {
+            std::string name;
+            for (char c : stats[i].name) {
+                if (c == '"' || c == '\\')
+                    name += '\\';
+                name += c;
+            }
+            os << "  {\"name\": \"" << name
+               << "\", \"count\": " << stats[i].count
+               << ", \"mean_ns\": " << stats[i].mean_ns
+               << ", \"p50_ns\": " << stats[i].p50_ns
+               << ", \"p99_ns\": " << stats[i].p99_ns
+               << ", \"p999_ns\": " << stats[i].p999_ns
+               << ", \"max_ns\": " << stats[i].max_ns << '}'
+               << (i + 1 < stats.size() ? "," : "") << '\n';
+        }
+        os << "]}\n";
+    }
+};
+
+// times invocations of one hook
+template <bool Enabled = TEMPLATE_METHOD_LATENCY>
+class Latency_Hook {
+    std::size_t id_;
+
+  public:
+    explicit Latency_Hook(std::string name)
+        : id_{Latency_Registry::get_instance().register_hook(std::move(name))} {
+    }
+    template <typename F>
+    void time(F&& f) const {
+        auto start = Tick_Clock::now();
+        std::forward<F>(f)();
+        auto ns = Tick_Clock::to_ns(Tick_Clock::now() - start);
+        Latency_Registry::get_instance().record(id_, ns);
+    }
+};
+
+// disabled: no registration, no timestamps, just the call
+template <>
+class Latency_Hook<false> {
+  public:
+    explicit Latency_Hook(const std::string&) {}
+    template <typename F>
+    void time(F&& f) const {
+        std::forward<F>(f)();
+    }
+};
+
+// the reusable template method: call() runs the before/f/after hooks of
+// Derived (resolved at compile time) and times each of them
+// Derived provides a static name() and may hide any of the default hooks
+template <typename Derived>
+class Base {
+    struct Hooks {
+        Latency_Hook<> before{std::string{Derived::name()} + "::before"};
+        Latency_Hook<> f{std::string{Derived::name()} + "::f"};
+        Latency_Hook<> after{std::string{Derived::name()} + "::after"};
+    };
+    static const Hooks& hooks() {
+        static const Hooks instance;
+        return instance;
+    }
+
+  protected:
+    void before() {}
+    void f() {}
+    void after() {}
+
+  public:
+    void call() {
+        auto& self = static_cast<Derived&>(*this);
+        hooks().before.time([&] { self.before(); });
+        hooks().f.time([&] { self.f(); });
+        hooks().after.time([&] { self.after(); });
+    }
+};
+
+// concrete pipelines
+class Parse : public Base<Parse> {
+    friend class Base<Parse>;
+    std::vector<int> fields_{};
+    void before() { fields_.clear(); }
+    void f() {
+        for (int i = 0; i < 64; ++i)
+            fields_.push_back(i * i);
+    }
+
+  public:
+    static const char* name() { return "Parse"; }
+    std::size_t size() const { return fields_.size(); }
+};
+
+class Checksum : public Base<Checksum> {
+    friend class Base<Checksum>;
+    std::uint64_t sum_ = 0;
+    void f() {
+        for (int i = 0; i < 256; ++i)
+            sum_ = sum_ * 31 + i;
+    }
+    void after() {
+        if (sum_ % 1000 == 0) // occasional slow path
+            std::this_thread::sleep_for(std::chrono::microseconds{50});
+    }
+
+  public:
+    static const char* name() { return "Checksum"; }
+    std::uint64_t sum() const { return sum_; }
+};
+
+int main() {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t)
+        workers.emplace_back([] {
+            Parse parse;
+            Checksum checksum;
+            for (int i = 0; i < 100000; ++i) {
+                parse.call();
+                checksum.call();
+            }
+        });
+    for (auto&& worker : workers)
+        worker.join();
+
+    if (!TEMPLATE_METHOD_LATENCY) {
+        std::cout << "Latency instrumentation disabled\n";
+        return 0;
+    }
+    std::cout << std::left << std::setw(20) << "hook" << std::right
+              << std::setw(10) << "count" << std::setw(10) << "p50 ns"
+              << std::setw(10) << "p99 ns" << std::setw(10) << "p999 ns"
+              << std::setw(10) << "max ns" << '\n';
+    for (auto&& stats : Latency_Registry::get_instance().snapshot())
+        std::cout << std::left << std::setw(20) << stats.name << std::right
+                  << std::setw(10) << stats.count << std::setw(10)
+                  << stats.p50_ns << std::setw(10) << stats.p99_ns
+                  << std::setw(10) << stats.p999_ns << std::setw(10)
+                  << stats.max_ns << '\n';
+    std::cout << '\n';
+    Latency_Registry::get_instance().export_json(std::cout);
+}
@@ -0,0 +1,369 @@
+// Visitor design pattern, parallel variant
+// a collection is split into chunks that worker threads visit in parallel,
+// idle workers steal chunks from busy ones; reduction visitors build one
+// partial result per worker and the partials are combined at the end, while
+// stateless visitors are shared by all workers as they are
+
+// compile with g++ -std=c++14 -O2 -pthread visitor_parallel.cpp
+// -ovisitor_parallel
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "bench/bench.h"
+
+// object hierarchy we will visit
+class IObject {
+  public:
+    virtual void accept(class IVisitor& visitor) = 0;
+    virtual ~IObject() = default;
+};
+
+class Car : public IObject {
+  public:
+    int passengers = 0;
+    std::size_t services = 0;
+    explicit Car(int passengers) : passengers{passengers} {}
+    void accept(IVisitor& visitor) override;
+};
+
+class Plane : public IObject {
+  public:
+    int passengers = 0;
+    std::size_t services = 0;
+    explicit Plane(int passengers) : passengers{passengers} {}
+    void accept(IVisitor& visitor) override;
+};
+
+class Train : public IObject {
+  public:
+    int passengers = 0;
+    std::size_t services = 0;
+    explicit Train(int passengers) : passengers{passengers} {}
+    void accept(IVisitor& visitor) override;
+};
+
+// visitor hierarchy
+class IVisitor {
+  public:
+    virtual void visit(Car& car) = 0;
+    virtual void visit(Plane& plane) = 0;
+    virtual void visit(Train& plane) = 0;
+    // true if visit() neither reads nor writes the visitor itself, a single
+    // instance may then run on all threads at once
+    virtual bool stateless() const { return false; }
+    virtual ~IVisitor() = default;
+};
+
+// accept the visitor(s)
+void Car::accept(IVisitor& visitor) { visitor.visit(*this); }
+
+void Plane::accept(IVisitor& visitor) { visitor.visit(*this); }
+
+void Train::accept(IVisitor& visitor) { visitor.visit(*this); }
+
+// visitor whose state is a result: every worker visits with a fresh copy
+// and the copies are combined into the original, in no particular order
+// (combine() must be associative and commutative)
+class IReduction_Visitor : public IVisitor {
+  public:
+    // same configuration, empty result
+    virtual std::unique_ptr<IReduction_Visitor> fresh() const = 0;
+    virtual void combine(const IReduction_Visitor& partial) = 0;
+};
+
+// implements fresh()/combine() in terms of Derived::empty() and
+// Derived::combine(const Derived&)
+template <typename Derived>
+class Reduction_Visitor : public IReduction_Visitor {
+    // a partial written on every visit, padded so that the partials of two
+    // workers (allocated one after the other) never share a cache line
+    class Padded_Partial : public Derived {
+        char _padding[64]{};
+
+      public:
+        explicit Padded_Partial(Derived empty) : Derived(std::move(empty)) {}
+    };
+
+  public:
+    std::unique_ptr<IReduction_Visitor> fresh() const override {
+        return std::make_unique<Padded_Partial>(
+            static_cast<const Derived&>(*this).empty());
+    }
+    void combine(const IReduction_Visitor& partial) override {
+        static_cast<Derived&>(*this).combine(
+            static_cast<const Derived&>(partial));
+    }
+};
+
+// chunk indices [begin, end) of one worker, packed in one atomic word; the
+// owner takes chunks from the front, thieves take half from the back
+class Chunk_Range {
+    std::atomic<std::uint64_t> _bits{0};
+    // the ranges of the workers sit in one vector, one cache line each
+    char _padding[64 - sizeof(std::atomic<std::uint64_t>)]{};
+
+    static std::uint64_t pack(std::uint32_t begin, std::uint32_t end) {
+        return std::uint64_t{begin} << 32 | end;
+    }
+
+  public:
+    void assign(std::uint32_t begin, std::uint32_t end) {
+        _bits.store(pack(begin, end));
+    }
+    bool pop_front(std::uint32_t& chunk) {
+        std::uint64_t bits = _bits.load();
+        for (;;) {
+            std::uint32_t begin = bits >> 32, end = bits & 0xffffffff;
+            if (begin >= end)
+                return false;
+            if (_bits.compare_exchange_weak(bits, pack(begin + 1, end))) {
+                chunk = begin;
+                return true;
+            }
+        }
+    }
+    bool steal_half(std::uint32_t& first, std::uint32_t& last) {
+        std::uint64_t bits = _bits.load();
+        for (;;) {
+            std::uint32_t begin = bits >> 32, end = bits & 0xffffffff;
+            if (begin >= end)
+                return false;
+            std::uint32_t middle = begin + (end - begin) / 2;
+            if (_bits.compare_exchange_weak(bits, pack(begin, middle))) {
+                first = middle;
+                last = end;
+                return true;
+            }
+        }
+    }
+};
+
+struct Parallel_Options {
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t chunk_size = 1024; // objects per chunk
+};
+
+using Objects = std::vector<std::reference_wrapper<IObject>>;
+
+// visits every object once, in parallel
+// stateless visitors are shared, reduction visitors are forked per worker
+// and combined back into visitor; any other visitor is rejected, as running
+// it on several threads would race on its state
+// an object must not appear twice in the collection
+void parallel_accept(const Objects& objects, IVisitor& visitor,
+                     Parallel_Options options = {}) {
+    auto* reduction = dynamic_cast<IReduction_Visitor*>(&visitor);
+    if (!visitor.stateless() && !reduction)
+        throw std::invalid_argument(
+            "parallel_accept: visitor is neither stateless nor a reduction");
+
+    const std::size_t chunk_size = std::max<std::size_t>(1, options.chunk_size);
+    const std::size_t n_chunks = (objects.size() + chunk_size - 1) / chunk_size;
+    if (n_chunks > 0xffffffff)
+        throw std::length_error("parallel_accept: too many chunks");
+    const std::size_t n_workers =
+        std::max<std::size_t>(1, std::min(options.threads, n_chunks));
+
+    std::vector<Chunk_Range> ranges(n_workers);
+    for (std::size_t w = 0; w < n_workers; ++w)
+        ranges[w].assign(static_cast<std::uint32_t>(n_chunks * w / n_workers),
+                         static_cast<std::uint32_t>(n_chunks * (w + 1) /
+                                                    n_workers));
+    std::vector<std::unique_ptr<IReduction_Visitor>> partials(n_workers);
+    if (!visitor.stateless())
+        for (auto&& partial : partials)
+            partial = reduction->fresh();
+
+    auto work = [&](std::size_t w) {
+        IVisitor& local = partials[w] ? *partials[w] : visitor;
+        auto visit_chunk = [&](std::uint32_t chunk) {
+            std::size_t first = chunk * chunk_size;
+            std::size_t last = std::min(objects.size(), first + chunk_size);
+            for (std::size_t i = first; i < last; ++i)
+                objects[i].get().accept(local);
+        };
+        for (;;) {
+            std::uint32_t chunk;
+            while (ranges[w].pop_front(chunk))
+                visit_chunk(chunk);
+            // out of work: steal from the others, starting with the next one
+            bool stolen = false;
+            for (std::size_t k = 1; k < n_workers && !stolen; ++k) {
+                std::uint32_t first, last;
+                if (ranges[(w + k) % n_workers].steal_half(first, last)) {
+                    ranges[w].assign(first, last);
+                    stolen = true;
+                }
+            }
+            if (!stolen) // no range had work left
+                return;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t w = 1; w < n_workers; ++w)
+        workers.emplace_back(work, w);
+    work(0);
+    for (auto&& worker : workers)
+        worker.join();
+
+    for (auto&& partial : partials)
+        if (partial)
+            reduction->combine(*partial);
+}
+
+// counts the objects and their passengers, per type
+class Census_Visitor : public Reduction_Visitor<Census_Visitor> {
+  public:
+    std::size_t cars = 0, planes = 0, trains = 0;
+    long long passengers = 0;
+
+    void visit(Car& car) override {
+        ++cars;
+        passengers += car.passengers;
+    }
+    void visit(Plane& plane) override {
+        ++planes;
+        passengers += plane.passengers;
+    }
+    void visit(Train& train) override {
+        ++trains;
+        passengers += train.passengers;
+    }
+
+    Census_Visitor empty() const { return {}; }
+    void combine(const Census_Visitor& partial) {
+        cars += partial.cars;
+        planes += partial.planes;
+        trains += partial.trains;
+        passengers += partial.passengers;
+    }
+};
+
+// largest passenger count among the objects of the types it looks at
+class Max_Passengers_Visitor
+    : public Reduction_Visitor<Max_Passengers_Visitor> {
+    bool _trains_only;
+
+  public:
+    int max = 0;
+    explicit Max_Passengers_Visitor(bool trains_only = false)
+        : _trains_only{trains_only} {}
+
+    void visit(Car& car) override {
+        if (!_trains_only)
+            max = std::max(max, car.passengers);
+    }
+    void visit(Plane& plane) override {
+        if (!_trains_only)
+            max = std::max(max, plane.passengers);
+    }
+    void visit(Train& train) override { max = std::max(max, train.passengers); }
+
+    Max_Passengers_Visitor empty() const {
+        return Max_Passengers_Visitor{_trains_only};
+    }
+    void combine(const Max_Passengers_Visitor& partial) {
+        max = std::max(max, partial.max);
+    }
+};
+
+// only touches the visited objects, so one instance serves every thread
+class Service_Visitor : public IVisitor {
+  public:
+    bool stateless() const override { return true; }
+    void visit(Car& car) override { ++car.services; }
+    void visit(Plane& plane) override { ++plane.services; }
+    void visit(Train& train) override { ++train.services; }
+};
+
+int main(int argc, char** argv) {
+    // large mixed collection
+    const std::size_t N = 1 << 20;
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> kind(0, 2), passengers(1, 500);
+    std::vector<std::unique_ptr<IObject>> owned;
+    for (std::size_t i = 0; i < N; ++i) {
+        switch (kind(gen)) {
+            case 0:
+                owned.push_back(std::make_unique<Car>(passengers(gen) % 5));
+                break;
+            case 1:
+                owned.push_back(std::make_unique<Plane>(passengers(gen)));
+                break;
+            default:
+                owned.push_back(std::make_unique<Train>(passengers(gen)));
+        }
+    }
+    Objects objects;
+    for (auto&& object : owned)
+        objects.emplace_back(*object);
+
+    // serial and parallel results agree
+    Census_Visitor serial;
+    for (auto&& elem : objects)
+        elem.get().accept(serial);
+    Census_Visitor census;
+    parallel_accept(objects, census);
+    std::cout << "Serial:   " << serial.cars << " cars, " << serial.planes
+              << " planes, " << serial.trains << " trains, "
+              << serial.passengers << " passengers\n";
+    std::cout << "Parallel: " << census.cars << " cars, " << census.planes
+              << " planes, " << census.trains << " trains, "
+              << census.passengers << " passengers\n";
+
+    Max_Passengers_Visitor max_train{true};
+    parallel_accept(objects, max_train, {4, 256});
+    std::cout << "Largest train: " << max_train.max << " passengers\n";
+
+    Service_Visitor service;
+    parallel_accept(objects, service);
+    auto first_car = std::find_if(owned.begin(), owned.end(), [](auto&& p) {
+        return dynamic_cast<Car*>(p.get()) != nullptr;
+    });
+    std::cout << "Serviced the first car "
+              << static_cast<Car&>(**first_car).services << " time(s)\n";
+
+    class Printing_Visitor : public IVisitor {
+        void visit(Car&) override { std::cout << "Car\n"; }
+        void visit(Plane&) override { std::cout << "Plane\n"; }
+        void visit(Train&) override { std::cout << "Train\n"; }
+    } printer;
+    try {
+        parallel_accept(objects, printer);
+    } catch (const std::invalid_argument& e) {
+        std::cout << e.what() << "\n\n";
+    }
+
+    // ops are passes over all N objects
+    bench::Suite suite{"visitor_parallel", argc, argv};
+    suite.add("serial", [&](std::size_t n) {
+        Census_Visitor visitor;
+        for (std::size_t i = 0; i < n; ++i)
+            for (auto&& elem : objects)
+                elem.get().accept(visitor);
+        bench::do_not_optimize(visitor.passengers);
+    });
+    std::size_t max_threads =
+        std::max<std::size_t>(4, Parallel_Options{}.threads);
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2)
+        suite.add("parallel/threads=" + std::to_string(threads),
+                  [&, threads](std::size_t n) {
+                      Census_Visitor visitor;
+                      for (std::size_t i = 0; i < n; ++i)
+                          parallel_accept(objects, visitor, {threads, 4096});
+                      bench::do_not_optimize(visitor.passengers);
+                  });
+    return suite.run();
+}
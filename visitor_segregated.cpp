@@ -0,0 +1,234 @@
+// Visitor design pattern, type-segregated collection
+// every concrete object type lives in its own contiguous segment, objects are
+// inserted by value (no per-element heap allocation) and visited segment by
+// segment, so within a segment the visit call always has the same target and
+// can be resolved once and inlined
+
+// compile with g++ -std=c++14 -O2 visitor_segregated.cpp -ovisitor_segregated
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bench/bench.h"
+
+// object hierarchy we will visit
+class IObject {
+  public:
+    virtual void accept(class IVisitor& visitor) = 0;
+    virtual ~IObject() = default;
+};
+
+class Car : public IObject {
+  public:
+    int speed = 0;
+    Car() = default;
+    explicit Car(int speed) : speed{speed} {}
+    std::string car() const { return "Car"; }
+    void accept(IVisitor& visitor) override;
+};
+
+class Plane : public IObject {
+  public:
+    int altitude = 0;
+    Plane() = default;
+    explicit Plane(int altitude) : altitude{altitude} {}
+    std::string plane() const { return "Plane"; }
+    void accept(IVisitor& visitor) override;
+};
+
+class Train : public IObject {
+  public:
+    int wagons = 0;
+    Train() = default;
+    explicit Train(int wagons) : wagons{wagons} {}
+    std::string train() const { return "Train"; }
+    void accept(IVisitor& visitor) override;
+};
+
+// visitor hierarchy
+class IVisitor {
+  public:
+    virtual void visit(Car& car) = 0;
+    virtual void visit(Plane& plane) = 0;
+    virtual void visit(Train& plane) = 0;
+    virtual ~IVisitor() = default;
+};
+
+// accept the visitor(s)
+void Car::accept(IVisitor& visitor) { visitor.visit(*this); }
+
+void Plane::accept(IVisitor& visitor) { visitor.visit(*this); }
+
+void Train::accept(IVisitor& visitor) { visitor.visit(*this); }
+
+// polymorphic collection, one std::vector per concrete type
+template <typename... Ts>
+class Poly_Collection {
+    std::tuple<std::vector<Ts>...> _segments;
+
+    template <typename T, typename... Us>
+    struct Index_Of;
+    template <typename T, typename... Us>
+    struct Index_Of<T, T, Us...> : std::integral_constant<std::size_t, 0> {};
+    template <typename T, typename U, typename... Us>
+    struct Index_Of<T, U, Us...>
+        : std::integral_constant<std::size_t, 1 + Index_Of<T, Us...>::value> {
+    };
+
+    // calls f(segment) on every segment, in the order of Ts
+    template <typename F>
+    void for_each_segment(F&& f) {
+        using expand = int[];
+        (void) expand{0, (f(std::get<std::vector<Ts>>(_segments)), 0)...};
+    }
+
+  public:
+    template <typename T>
+    std::vector<T>& segment() {
+        return std::get<Index_Of<T, Ts...>::value>(_segments);
+    }
+
+    template <typename T>
+    T& insert(T value) {
+        auto& seg = segment<T>();
+        seg.push_back(std::move(value));
+        return seg.back();
+    }
+
+    template <typename T, typename... Args>
+    T& emplace(Args&&... args) {
+        auto& seg = segment<T>();
+        seg.emplace_back(std::forward<Args>(args)...);
+        return seg.back();
+    }
+
+    std::size_t size() const {
+        std::size_t result = 0;
+        using expand = int[];
+        (void) expand{
+            0, (result += std::get<std::vector<Ts>>(_segments).size(), 0)...};
+        return result;
+    }
+
+    // run-time visitor: the object type of a segment is known statically,
+    // only the (per segment constant) visitor call is dynamic
+    void accept(IVisitor& visitor) {
+        for_each_segment([&visitor](auto& seg) {
+            for (auto& object : seg)
+                visitor.visit(object);
+        });
+    }
+
+    // compile-time visitor: with a final Visitor every call is inlined
+    template <typename Visitor>
+    void visit_all(Visitor& visitor) {
+        for_each_segment([&visitor](auto& seg) {
+            for (auto& object : seg)
+                visitor.visit(object);
+        });
+    }
+};
+
+// define as many visitors as you want
+class VisitorOne final : public IVisitor {
+  public:
+    void visit(Car& car) override {
+        std::cout << "Visitor one on " << car.car() << '\n';
+    }
+    void visit(Plane& plane) override {
+        std::cout << "Visitor one on " << plane.plane() << '\n';
+    }
+    void visit(Train& train) override {
+        std::cout << "Visitor one on " << train.train() << '\n';
+    }
+};
+
+// sums up a number per object type
+class Summing_Visitor final : public IVisitor {
+  public:
+    long long total = 0;
+    void visit(Car& car) override { total += car.speed; }
+    void visit(Plane& plane) override { total += 2 * plane.altitude; }
+    void visit(Train& train) override { total += 3 * train.wagons; }
+};
+
+int main(int argc, char** argv) {
+    Poly_Collection<Car, Plane, Train> collection;
+    collection.insert(Train{4});
+    collection.insert(Car{120});
+    collection.emplace<Plane>(9000);
+    collection.insert(Car{50});
+
+    // visited segment by segment: cars first, then planes, then trains
+    VisitorOne vis_one;
+    collection.accept(vis_one);
+    std::cout << '\n';
+
+    // mixed-type workload, the same objects in both collections
+    const std::size_t N = 1 << 16;
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> kind(0, 2), value(0, 100);
+    std::vector<std::unique_ptr<IObject>> owned;
+    Poly_Collection<Car, Plane, Train> segregated;
+    for (std::size_t i = 0; i < N; ++i) {
+        int v = value(gen);
+        switch (kind(gen)) {
+            case 0:
+                owned.push_back(std::make_unique<Car>(v));
+                segregated.insert(Car{v});
+                break;
+            case 1:
+                owned.push_back(std::make_unique<Plane>(v));
+                segregated.insert(Plane{v});
+                break;
+            default:
+                owned.push_back(std::make_unique<Train>(v));
+                segregated.insert(Train{v});
+        }
+    }
+    // long-lived heaps rarely hand out objects in visiting order
+    std::shuffle(owned.begin(), owned.end(), gen);
+    std::vector<std::reference_wrapper<IObject>> objects;
+    for (auto&& object : owned)
+        objects.emplace_back(*object);
+
+    Summing_Visitor check_mixed, check_segregated;
+    for (auto&& elem : objects)
+        elem.get().accept(check_mixed);
+    segregated.accept(check_segregated);
+    std::cout << "Totals: " << check_mixed.total << " (mixed), "
+              << check_segregated.total << " (segregated)\n\n";
+
+    // ops are passes over all N objects
+    bench::Suite suite{"visitor_segregated", argc, argv};
+    suite.add("reference_wrapper_vector", [&](std::size_t n) {
+        Summing_Visitor visitor;
+        IVisitor& ivisitor = visitor;
+        for (std::size_t i = 0; i < n; ++i)
+            for (auto&& elem : objects)
+                elem.get().accept(ivisitor);
+        bench::do_not_optimize(visitor.total);
+    });
+    suite.add("segregated/accept", [&](std::size_t n) {
+        Summing_Visitor visitor;
+        IVisitor& ivisitor = visitor;
+        for (std::size_t i = 0; i < n; ++i)
+            segregated.accept(ivisitor);
+        bench::do_not_optimize(visitor.total);
+    });
+    suite.add("segregated/visit_all", [&](std::size_t n) {
+        Summing_Visitor visitor;
+        for (std::size_t i = 0; i < n; ++i)
+            segregated.visit_all(visitor);
+        bench::do_not_optimize(visitor.total);
+    });
+    return suite.run();
+}